@@ -11,6 +11,13 @@
 #define US_FLOAT2(x) x
 #endif
 
+#ifndef TARGET_N64
+// Modulation advances once per audio update, and higher output rates have more updates per frame
+#define PER_UPDATE_STEP(step) ((step) / gAudioUpdateRateScale)
+#else
+#define PER_UPDATE_STEP(step) (step)
+#endif
+
 #ifdef VERSION_EU
 static void sequence_channel_process_sound(struct SequenceChannel *seqChannel, s32 recalculateVolume) {
     f32 channelVolume;
@@ -149,7 +156,7 @@ f32 get_portamento_freq_scale(struct Portamento *p) {
     }
 #endif
 
-    p->cur += p->speed;
+    p->cur += PER_UPDATE_STEP(p->speed);
     v0 = (u32) p->cur;
 
 #ifdef VERSION_EU
@@ -172,14 +179,14 @@ f32 get_portamento_freq_scale(struct Portamento *p) {
 #ifdef VERSION_EU
 s16 get_vibrato_pitch_change(struct VibratoState *vib) {
     s32 index;
-    vib->time += (s32) vib->rate;
+    vib->time += (s32) PER_UPDATE_STEP(vib->rate);
     index = (vib->time >> 10) & 0x3F;
     return vib->curve[index] >> 8;
 }
 #else
 s8 get_vibrato_pitch_change(struct VibratoState *vib) {
     s32 index;
-    vib->time += vib->rate;
+    vib->time += (u32) PER_UPDATE_STEP(vib->rate);
 
     index = (vib->time >> 10) & 0x3F;
 
@@ -414,6 +421,13 @@ s32 adsr_update(struct AdsrState *adsr) {
                     adsr->target = adsr->target * adsr->target;
                     adsr->velocity = (adsr->target - adsr->current) / adsr->delay;
 #else
+#ifndef TARGET_N64
+                    // Same as EU, stretch the envelope over the extra updates
+                    if (gAudioUpdateRateScale != 1.0f && adsr->delay >= 4) {
+                        f32 delay = adsr->delay * gAudioUpdateRateScale;
+                        adsr->delay = delay < 0x7fff ? delay : 0x7fff;
+                    }
+#endif
                     adsr->target = BSWAP16(adsr->envelope[adsr->envIndex].arg);
                     adsr->velocity = ((adsr->target - adsr->current) << 0x10) / adsr->delay;
 #endif
@@ -13,6 +13,77 @@
 #include "seq_ids.h"
 #include "dialog_ids.h"
 
+#ifndef TARGET_N64
+#include "../pc/audio/audio_thread.h"
+#endif
+
+#ifdef AUDIO_THREAD
+// While the PC audio thread is running it owns all sound state, so the sound calls made
+// by the game are queued and replayed on that thread in the same order.
+#define AUDIO_COMMAND0(func)                                                                       \
+    static void func##_command(UNUSED uintptr_t *args) {                                           \
+        func();                                                                                    \
+    }
+#define AUDIO_COMMAND1(func, t0)                                                                   \
+    static void func##_command(uintptr_t *args) {                                                  \
+        func((t0) args[0]);                                                                        \
+    }
+#define AUDIO_COMMAND2(func, t0, t1)                                                               \
+    static void func##_command(uintptr_t *args) {                                                  \
+        func((t0) args[0], (t1) args[1]);                                                          \
+    }
+#define AUDIO_COMMAND3(func, t0, t1, t2)                                                           \
+    static void func##_command(uintptr_t *args) {                                                  \
+        func((t0) args[0], (t1) args[1], (t2) args[2]);                                            \
+    }
+#define AUDIO_COMMAND4(func, t0, t1, t2, t3)                                                       \
+    static void func##_command(uintptr_t *args) {                                                  \
+        func((t0) args[0], (t1) args[1], (t2) args[2], (t3) args[3]);                              \
+    }
+#define DEFER_AUDIO_COMMAND(func, a0, a1, a2, a3)                                                  \
+    if (audio_thread_defer(func##_command, (uintptr_t)(a0), (uintptr_t)(a1), (uintptr_t)(a2),     \
+                           (uintptr_t)(a3))) {                                                     \
+        return;                                                                                    \
+    }
+
+AUDIO_COMMAND2(play_sound, s32, f32 *)
+AUDIO_COMMAND0(audio_signal_game_loop_tick)
+AUDIO_COMMAND2(sequence_player_fade_out, u8, u16)
+AUDIO_COMMAND3(fade_volume_scale, u8, u8, u16)
+AUDIO_COMMAND3(func_8031FFB4, u8, u16, u8)
+AUDIO_COMMAND2(sequence_player_unlower, u8, u16)
+AUDIO_COMMAND1(set_sound_disabled, u8)
+AUDIO_COMMAND2(func_803205E8, u32, f32 *)
+AUDIO_COMMAND1(func_803206F8, f32 *)
+AUDIO_COMMAND0(func_80320890)
+AUDIO_COMMAND2(sound_banks_disable, u8, u16)
+AUDIO_COMMAND2(sound_banks_enable, u8, u16)
+AUDIO_COMMAND2(func_80320A4C, u8, u8)
+AUDIO_COMMAND1(play_dialog_sound, u8)
+AUDIO_COMMAND3(play_music, u8, u16, u16)
+AUDIO_COMMAND1(stop_background_music, u16)
+AUDIO_COMMAND2(fadeout_background_music, u16, u16)
+AUDIO_COMMAND0(drop_queued_background_music)
+AUDIO_COMMAND4(play_secondary_music, u8, u8, u8, u16)
+AUDIO_COMMAND1(func_80321080, u16)
+AUDIO_COMMAND1(func_803210D4, u16)
+AUDIO_COMMAND0(play_course_clear)
+AUDIO_COMMAND0(play_peachs_jingle)
+AUDIO_COMMAND0(play_puzzle_jingle)
+AUDIO_COMMAND0(play_star_fanfare)
+AUDIO_COMMAND1(play_power_star_jingle, u8)
+AUDIO_COMMAND0(play_race_fanfare)
+AUDIO_COMMAND0(play_toads_jingle)
+AUDIO_COMMAND1(sound_reset, u8)
+AUDIO_COMMAND1(audio_set_sound_mode, u8)
+// Calls that return sound state first wait for the queued commands, so that the game sees
+// the result of its own earlier calls and the audio thread isn't changing that state meanwhile
+#define SYNC_AUDIO_COMMANDS() audio_thread_sync()
+#else
+#define DEFER_AUDIO_COMMAND(func, a0, a1, a2, a3)
+#define SYNC_AUDIO_COMMANDS()
+#endif
+
 #ifdef VERSION_EU
 #define EU_FLOAT(x) x ## f
 #else
@@ -192,6 +263,17 @@ struct SoundCharacteristics {
     u8 unk19; // ttl? sometimes set to 10
     u8 prev;
     u8 next;
+#ifndef TARGET_N64
+    // Derived from the source position, see update_sound_position
+    u8 positionValid;
+    s16 intensityLevel; // level the cached intensity is for, -1 once the sound moves
+    f32 lastX;
+    f32 lastY;
+    f32 lastZ;
+    f32 pan;
+    f32 intensity; // volume falloff before vibrato, for intensityArg
+    f32 intensityArg;
+#endif
 }; // size = 0x1C
 
 struct SequenceQueueItem {
@@ -530,6 +612,9 @@ extern void func_802ad74c(u32 bits, u32 arg);
 extern void func_802ad770(u32 bits, s8 arg);
 
 void func_8031E0E4(u8 bankIndex, u8 item);
+#ifndef TARGET_N64
+f32 get_sound_pan(f32 x, f32 z);
+#endif
 
 // Local functions that could be static but are defined in/called from GLOBAL_ASM blocks,
 // or not part of the large block of static functions.
@@ -883,7 +968,38 @@ void create_next_audio_buffer(s16 *samples, u32 num_samples) {
 #endif
 #endif
 
+#ifndef TARGET_N64
+/**
+ * Recomputes the distance and pan of a sound only when its source has moved
+ * since the last update, and drops the cached volume falloff if so.
+ */
+static void update_sound_position(u8 bankIndex, u8 item) {
+    struct SoundCharacteristics *sound = &gSoundBanks[bankIndex][item];
+    f32 x = *sound->x;
+    f32 y = *sound->y;
+    f32 z = *sound->z;
+
+    if (sound->positionValid && x == sound->lastX && y == sound->lastY && z == sound->lastZ) {
+        return;
+    }
+    sound->distance = sqrtf(x * x + y * y + z * z);
+    sound->pan = get_sound_pan(x, z);
+    sound->intensityLevel = -1;
+    sound->lastX = x;
+    sound->lastY = y;
+    sound->lastZ = z;
+    sound->positionValid = TRUE;
+}
+
+// The pan of a sound only changes when it moves, so update_game_sound uses the value kept with it
+static f32 get_cached_sound_pan(u8 bankIndex, u8 item) {
+    update_sound_position(bankIndex, item);
+    return gSoundBanks[bankIndex][item].pan;
+}
+#endif
+
 void play_sound(s32 soundBits, f32 *pos) {
+    DEFER_AUDIO_COMMAND(play_sound, soundBits, pos, 0, 0);
     sSoundRequests[sSoundRequestCount].soundBits = soundBits;
     sSoundRequests[sSoundRequestCount].position = pos;
     sSoundRequestCount++;
@@ -894,8 +1010,10 @@ void process_sound_request(u32 bits, f32 *pos) {
     u8 index;
     u8 counter = 0;
     u8 soundId;
+#ifdef TARGET_N64
     f32 dist;
     const f32 one = 1.0f;
+#endif
 
     bankIndex = (bits & SOUNDARGS_MASK_BANK) >> SOUNDARGS_SHIFT_BANK;
     soundId = (bits & SOUNDARGS_MASK_SOUNDID) >> SOUNDARGS_SHIFT_SOUNDID;
@@ -930,11 +1048,18 @@ void process_sound_request(u32 bits, f32 *pos) {
 
     if (gSoundBanks[bankIndex][D_803320B0[bankIndex]].next != 0xff && index != 0) {
         index = D_803320B0[bankIndex];
+#ifdef TARGET_N64
         dist = sqrtf(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]) * one;
+#endif
         gSoundBanks[bankIndex][index].x = &pos[0];
         gSoundBanks[bankIndex][index].y = &pos[1];
         gSoundBanks[bankIndex][index].z = &pos[2];
+#ifdef TARGET_N64
         gSoundBanks[bankIndex][index].distance = dist;
+#else
+        gSoundBanks[bankIndex][index].positionValid = FALSE;
+        update_sound_position(bankIndex, index);
+#endif
         gSoundBanks[bankIndex][index].soundBits = bits;
         gSoundBanks[bankIndex][index].soundStatus = bits & SOUNDARGS_MASK_STATUS;
         gSoundBanks[bankIndex][index].unk19 = 10;
@@ -1025,11 +1150,15 @@ void func_8031E16C(u8 bankIndex) {
 
         if (gSoundBanks[bankIndex][soundIndex].soundStatus != SOUND_STATUS_STOPPED
             && soundIndex == spDB) {
+#ifdef TARGET_N64
             gSoundBanks[bankIndex][soundIndex].distance =
                 sqrtf((*gSoundBanks[bankIndex][soundIndex].x * *gSoundBanks[bankIndex][soundIndex].x)
                       + (*gSoundBanks[bankIndex][soundIndex].y * *gSoundBanks[bankIndex][soundIndex].y)
                       + (*gSoundBanks[bankIndex][soundIndex].z * *gSoundBanks[bankIndex][soundIndex].z))
                 * 1;
+#else
+            update_sound_position(bankIndex, soundIndex);
+#endif
 
             val = (gSoundBanks[bankIndex][soundIndex].soundBits & SOUNDARGS_MASK_PRIORITY)
                   >> SOUNDARGS_SHIFT_PRIORITY;
@@ -1178,6 +1307,12 @@ f32 get_sound_dynamics(u8 bankIndex, u8 item, f32 arg2) {
 #endif
 
     if (!(gSoundBanks[bankIndex][item].soundBits & SOUND_NO_VOLUME_LOSS)) {
+#ifndef TARGET_N64
+        if (gSoundBanks[bankIndex][item].intensityLevel == gCurrLevelNum
+            && gSoundBanks[bankIndex][item].intensityArg == arg2) {
+            intensity = gSoundBanks[bankIndex][item].intensity;
+        } else {
+#endif
 #ifdef VERSION_JP
         f0 = D_80332028[gCurrLevelNum];
         if (f0 < gSoundBanks[bankIndex][item].distance) {
@@ -1199,6 +1334,12 @@ f32 get_sound_dynamics(u8 bankIndex, u8 item, f32 arg2) {
             }
         }
 #endif
+#ifndef TARGET_N64
+            gSoundBanks[bankIndex][item].intensity = intensity;
+            gSoundBanks[bankIndex][item].intensityArg = arg2;
+            gSoundBanks[bankIndex][item].intensityLevel = gCurrLevelNum;
+        }
+#endif
 
         if (gSoundBanks[bankIndex][item].soundBits & SOUND_VIBRATO) {
 #ifdef VERSION_JP
@@ -1269,6 +1410,7 @@ static void noop_8031EEC8(void) {
 }
 
 void audio_signal_game_loop_tick(void) {
+    DEFER_AUDIO_COMMAND(audio_signal_game_loop_tick, 0, 0, 0, 0);
     sGameLoopTicked = 1;
 #ifdef VERSION_EU
     maybe_tick_game_sound();
@@ -1343,12 +1485,22 @@ void update_game_sound(void) {
 #endif
                                 }
 #ifdef VERSION_EU
+#ifdef TARGET_N64
                                 func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
                                               get_sound_pan(*gSoundBanks[bankIndex][index].x,
                                                             *gSoundBanks[bankIndex][index].z));
 #else
+                                func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
+                                              get_cached_sound_pan(bankIndex, index));
+#endif
+#else
+#ifdef TARGET_N64
                                 gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan = get_sound_pan(
                                     *gSoundBanks[bankIndex][index].x, *gSoundBanks[bankIndex][index].z);
+#else
+                                gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan =
+                                    get_cached_sound_pan(bankIndex, index);
+#endif
 #endif
 
                                 if ((gSoundBanks[bankIndex][index].soundBits & SOUNDARGS_MASK_SOUNDID)
@@ -1403,16 +1555,26 @@ void update_game_sound(void) {
                                           get_sound_reverb(bankIndex, index, channelIndex));
                             func_802ad728(0x02020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_dynamics(bankIndex, index, ARG2_VAL1));
+#ifdef TARGET_N64
                             func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_pan(*gSoundBanks[bankIndex][index].x,
                                                         *gSoundBanks[bankIndex][index].z) * 127.0f + 0.5f);
+#else
+                            func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
+                                          get_cached_sound_pan(bankIndex, index) * 127.0f + 0.5f);
+#endif
                             func_802ad728(0x04020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_freq_scale(bankIndex, index));
 #else
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->volume =
                                 get_sound_dynamics(bankIndex, index, ARG2_VAL1);
+#ifdef TARGET_N64
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan = get_sound_pan(
                                 *gSoundBanks[bankIndex][index].x, *gSoundBanks[bankIndex][index].z);
+#else
+                            gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan =
+                                get_cached_sound_pan(bankIndex, index);
+#endif
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->freqScale =
                                 get_sound_freq_scale(bankIndex, index);
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->reverb =
@@ -1430,9 +1592,14 @@ void update_game_sound(void) {
                                           get_sound_reverb(bankIndex, index, channelIndex));
                             func_802ad728(0x02020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_dynamics(bankIndex, index, ARG2_VAL2));
+#ifdef TARGET_N64
                             func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_pan(*gSoundBanks[bankIndex][index].x,
                                                         *gSoundBanks[bankIndex][index].z) * 127.0f + 0.5f);
+#else
+                            func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
+                                          get_cached_sound_pan(bankIndex, index) * 127.0f + 0.5f);
+#endif
                             func_802ad728(0x04020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_freq_scale(bankIndex, index));
 #else
@@ -1440,8 +1607,13 @@ void update_game_sound(void) {
                                 get_sound_reverb(bankIndex, index, channelIndex);
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->volume =
                                 get_sound_dynamics(bankIndex, index, ARG2_VAL2);
+#ifdef TARGET_N64
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan = get_sound_pan(
                                 *gSoundBanks[bankIndex][index].x, *gSoundBanks[bankIndex][index].z);
+#else
+                            gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan =
+                                get_cached_sound_pan(bankIndex, index);
+#endif
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->freqScale =
                                 get_sound_freq_scale(bankIndex, index);
 #endif
@@ -1500,12 +1672,22 @@ void update_game_sound(void) {
 #endif
                                 }
 #ifdef VERSION_EU
+#ifdef TARGET_N64
                                 func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
                                               get_sound_pan(*gSoundBanks[bankIndex][index].x,
                                                             *gSoundBanks[bankIndex][index].z));
 #else
+                                func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
+                                              get_cached_sound_pan(bankIndex, index));
+#endif
+#else
+#ifdef TARGET_N64
                                 gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan = get_sound_pan(
                                     *gSoundBanks[bankIndex][index].x, *gSoundBanks[bankIndex][index].z);
+#else
+                                gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan =
+                                    get_cached_sound_pan(bankIndex, index);
+#endif
 #endif
 
                                 if ((gSoundBanks[bankIndex][index].soundBits & SOUNDARGS_MASK_SOUNDID)
@@ -1560,16 +1742,26 @@ void update_game_sound(void) {
                                           get_sound_reverb(bankIndex, index, channelIndex));
                             func_802ad728(0x02020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_dynamics(bankIndex, index, ARG2_VAL1));
+#ifdef TARGET_N64
                             func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_pan(*gSoundBanks[bankIndex][index].x,
                                                         *gSoundBanks[bankIndex][index].z) * 127.0f + 0.5f);
+#else
+                            func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
+                                          get_cached_sound_pan(bankIndex, index) * 127.0f + 0.5f);
+#endif
                             func_802ad728(0x04020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_freq_scale(bankIndex, index));
 #else
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->volume =
                                 get_sound_dynamics(bankIndex, index, ARG2_VAL1);
+#ifdef TARGET_N64
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan = get_sound_pan(
                                 *gSoundBanks[bankIndex][index].x, *gSoundBanks[bankIndex][index].z);
+#else
+                            gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan =
+                                get_cached_sound_pan(bankIndex, index);
+#endif
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->freqScale =
                                 get_sound_freq_scale(bankIndex, index);
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->reverb =
@@ -1587,9 +1779,14 @@ void update_game_sound(void) {
                                           get_sound_reverb(bankIndex, index, channelIndex));
                             func_802ad728(0x02020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_dynamics(bankIndex, index, ARG2_VAL2));
+#ifdef TARGET_N64
                             func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_pan(*gSoundBanks[bankIndex][index].x,
                                                         *gSoundBanks[bankIndex][index].z) * 127.0f + 0.5f);
+#else
+                            func_802ad770(0x03020000 | ((channelIndex & 0xff) << 8),
+                                          get_cached_sound_pan(bankIndex, index) * 127.0f + 0.5f);
+#endif
                             func_802ad728(0x04020000 | ((channelIndex & 0xff) << 8),
                                           get_sound_freq_scale(bankIndex, index));
 #else
@@ -1597,8 +1794,13 @@ void update_game_sound(void) {
                                 get_sound_reverb(bankIndex, index, channelIndex);
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->volume =
                                 get_sound_dynamics(bankIndex, index, ARG2_VAL2);
+#ifdef TARGET_N64
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan = get_sound_pan(
                                 *gSoundBanks[bankIndex][index].x, *gSoundBanks[bankIndex][index].z);
+#else
+                            gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->pan =
+                                get_cached_sound_pan(bankIndex, index);
+#endif
                             gSequencePlayers[SEQ_PLAYER_SFX].channels[channelIndex]->freqScale =
                                 get_sound_freq_scale(bankIndex, index);
 #endif
@@ -1658,6 +1860,7 @@ void play_sequence(u8 player, u8 seqId, u16 fadeTimer) {
 }
 
 void sequence_player_fade_out(u8 player, u16 fadeTimer) {
+    DEFER_AUDIO_COMMAND(sequence_player_fade_out, player, fadeTimer, 0, 0);
 #ifdef VERSION_EU
     if (!player) {
         sPlayer0CurSeqId = SEQUENCE_NONE;
@@ -1673,6 +1876,7 @@ void sequence_player_fade_out(u8 player, u16 fadeTimer) {
 
 void fade_volume_scale(u8 player, u8 targetScale, u16 fadeTimer) {
     u8 i;
+    DEFER_AUDIO_COMMAND(fade_volume_scale, player, targetScale, fadeTimer, 0);
     for (i = 0; i < CHANNELS_MAX; i++) {
         fade_channel_volume_scale(player, i, targetScale, fadeTimer);
     }
@@ -1882,6 +2086,7 @@ void unused_8031FED0(u8 player, u32 bits, s8 arg2) {
 }
 
 void func_8031FFB4(u8 player, u16 fadeTimer, u8 arg2) {
+    DEFER_AUDIO_COMMAND(func_8031FFB4, player, fadeTimer, arg2, 0);
     if (player == 0) {
         sCapVolumeTo40 = TRUE;
         func_803200E4(fadeTimer);
@@ -1891,6 +2096,7 @@ void func_8031FFB4(u8 player, u16 fadeTimer, u8 arg2) {
 }
 
 void sequence_player_unlower(u8 player, u16 fadeTimer) {
+    DEFER_AUDIO_COMMAND(sequence_player_unlower, player, fadeTimer, 0, 0);
     sCapVolumeTo40 = FALSE;
     if (player == 0) {
         if (gSequencePlayers[player].state != SEQUENCE_PLAYER_STATE_FADE_OUT) {
@@ -1951,6 +2157,8 @@ u8 func_803200E4(u16 fadeTimer) {
 void set_sound_disabled(u8 disabled) {
     u8 i;
 
+    DEFER_AUDIO_COMMAND(set_sound_disabled, disabled, 0, 0, 0);
+
     for (i = 0; i < SEQUENCE_PLAYERS; i++) {
 #ifdef VERSION_EU
         if (disabled)
@@ -2044,6 +2252,8 @@ void func_803205E8(u32 soundBits, f32 *vec) {
     u8 bankIndex;
     u8 item;
 
+    DEFER_AUDIO_COMMAND(func_803205E8, soundBits, vec, 0, 0);
+
     bankIndex = (soundBits & SOUNDARGS_MASK_BANK) >> SOUNDARGS_SHIFT_BANK;
     item = gSoundBanks[bankIndex][0].next;
     while (item != 0xff) {
@@ -2063,6 +2273,8 @@ void func_803206F8(f32 *arg0) {
     u8 bankIndex;
     u8 item;
 
+    DEFER_AUDIO_COMMAND(func_803206F8, arg0, 0, 0, 0);
+
     for (bankIndex = 0; bankIndex < SOUND_BANK_COUNT; bankIndex++) {
         item = gSoundBanks[bankIndex][0].next;
         while (item != 0xff) {
@@ -2086,6 +2298,7 @@ static void func_803207DC(u8 bankIndex) {
 }
 
 void func_80320890(void) {
+    DEFER_AUDIO_COMMAND(func_80320890, 0, 0, 0, 0);
     func_803207DC(1);
     func_803207DC(4);
     func_803207DC(6);
@@ -2094,6 +2307,8 @@ void func_80320890(void) {
 void sound_banks_disable(UNUSED u8 player, u16 bankMask) {
     u8 i;
 
+    DEFER_AUDIO_COMMAND(sound_banks_disable, player, bankMask, 0, 0);
+
     for (i = 0; i < SOUND_BANK_COUNT; i++) {
         if (bankMask & 1) {
             sSoundBankDisabled[i] = TRUE;
@@ -2113,6 +2328,8 @@ void disable_all_sequence_players(void) {
 void sound_banks_enable(UNUSED u8 player, u16 bankMask) {
     u8 i;
 
+    DEFER_AUDIO_COMMAND(sound_banks_enable, player, bankMask, 0, 0);
+
     for (i = 0; i < SOUND_BANK_COUNT; i++) {
         if (bankMask & 1) {
             sSoundBankDisabled[i] = FALSE;
@@ -2123,6 +2340,7 @@ void sound_banks_enable(UNUSED u8 player, u16 bankMask) {
 
 u8 unused_803209D8(u8 player, u8 channelIndex, u8 arg2) {
     u8 ret = 0;
+    SYNC_AUDIO_COMMANDS();
     if (gSequencePlayers[player].channels[channelIndex] != &gSequenceChannelNone) {
         gSequencePlayers[player].channels[channelIndex]->stopSomething2 = arg2;
         ret = arg2;
@@ -2131,12 +2349,15 @@ u8 unused_803209D8(u8 player, u8 channelIndex, u8 arg2) {
 }
 
 void func_80320A4C(u8 bankIndex, u8 arg1) {
+    DEFER_AUDIO_COMMAND(func_80320A4C, bankIndex, arg1, 0, 0);
     D_80363808[bankIndex] = arg1;
 }
 
 void play_dialog_sound(u8 dialogID) {
     u8 speaker;
 
+    DEFER_AUDIO_COMMAND(play_dialog_sound, dialogID, 0, 0, 0);
+
     if (dialogID >= DIALOG_COUNT) {
         dialogID = 0;
     }
@@ -2164,6 +2385,8 @@ void play_music(u8 player, u16 seqArgs, u16 fadeTimer) {
     u8 i;
     u8 foundIndex = 0;
 
+    DEFER_AUDIO_COMMAND(play_music, player, seqArgs, fadeTimer, 0);
+
     // Except for the background music player, we don't support queued
     // sequences. Just play them immediately, stopping any old sequence.
     if (player != 0) {
@@ -2221,6 +2444,8 @@ void stop_background_music(u16 seqId) {
     u8 foundIndex;
     u8 i;
 
+    DEFER_AUDIO_COMMAND(stop_background_music, seqId, 0, 0, 0);
+
     if (sBackgroundMusicQueueSize == 0) {
         return;
     }
@@ -2259,18 +2484,21 @@ void stop_background_music(u16 seqId) {
 }
 
 void fadeout_background_music(u16 seqId, u16 fadeOut) {
+    DEFER_AUDIO_COMMAND(fadeout_background_music, seqId, fadeOut, 0, 0);
     if (sBackgroundMusicQueueSize != 0 && sBackgroundMusicQueue[0].seqId == (u8)(seqId & 0xff)) {
         sequence_player_fade_out(SEQ_PLAYER_LEVEL, fadeOut);
     }
 }
 
 void drop_queued_background_music(void) {
+    DEFER_AUDIO_COMMAND(drop_queued_background_music, 0, 0, 0, 0);
     if (sBackgroundMusicQueueSize != 0) {
         sBackgroundMusicQueueSize = 1;
     }
 }
 
 u16 get_current_background_music(void) {
+    SYNC_AUDIO_COMMANDS();
     if (sBackgroundMusicQueueSize != 0) {
         return (sBackgroundMusicQueue[0].priority << 8) + sBackgroundMusicQueue[0].seqId;
     }
@@ -2305,6 +2533,8 @@ void func_80320ED8(void) {
 void play_secondary_music(u8 seqId, u8 bgMusicVolume, u8 volume, u16 fadeTimer) {
     UNUSED u32 dummy;
 
+    DEFER_AUDIO_COMMAND(play_secondary_music, seqId, bgMusicVolume, volume, fadeTimer);
+
     sUnused80332118 = 0;
     if (sPlayer0CurSeqId == 0xff || sPlayer0CurSeqId == SEQ_MENU_TITLE_SCREEN) {
         return;
@@ -2328,6 +2558,7 @@ void play_secondary_music(u8 seqId, u8 bgMusicVolume, u8 volume, u16 fadeTimer)
 }
 
 void func_80321080(u16 fadeTimer) {
+    DEFER_AUDIO_COMMAND(func_80321080, fadeTimer, 0, 0, 0);
     if (D_80363812 != 0) {
         D_80363812 = 0;
         D_80332120 = 0;
@@ -2340,6 +2571,8 @@ void func_80321080(u16 fadeTimer) {
 void func_803210D4(u16 fadeOutTime) {
     u8 i;
 
+    DEFER_AUDIO_COMMAND(func_803210D4, fadeOutTime, 0, 0, 0);
+
     if (sHasStartedFadeOut) {
         return;
     }
@@ -2368,6 +2601,7 @@ void func_803210D4(u16 fadeOutTime) {
 }
 
 void play_course_clear(void) {
+    DEFER_AUDIO_COMMAND(play_course_clear, 0, 0, 0, 0);
     play_sequence(SEQ_PLAYER_ENV, SEQ_EVENT_CUTSCENE_COLLECT_STAR, 0);
     D_8033211C = 0x80 | 0;
 #ifdef VERSION_EU
@@ -2377,6 +2611,7 @@ void play_course_clear(void) {
 }
 
 void play_peachs_jingle(void) {
+    DEFER_AUDIO_COMMAND(play_peachs_jingle, 0, 0, 0, 0);
     play_sequence(SEQ_PLAYER_ENV, SEQ_EVENT_PEACH_MESSAGE, 0);
     D_8033211C = 0x80 | 0;
 #ifdef VERSION_EU
@@ -2391,6 +2626,7 @@ void play_peachs_jingle(void) {
  * yoshi, releasing chain chomp, opening the pyramid top, etc.
  */
 void play_puzzle_jingle(void) {
+    DEFER_AUDIO_COMMAND(play_puzzle_jingle, 0, 0, 0, 0);
     play_sequence(SEQ_PLAYER_ENV, SEQ_EVENT_SOLVE_PUZZLE, 0);
     D_8033211C = 0x80 | 20;
 #ifdef VERSION_EU
@@ -2400,6 +2636,7 @@ void play_puzzle_jingle(void) {
 }
 
 void play_star_fanfare(void) {
+    DEFER_AUDIO_COMMAND(play_star_fanfare, 0, 0, 0, 0);
     play_sequence(SEQ_PLAYER_ENV, SEQ_EVENT_HIGH_SCORE, 0);
     D_8033211C = 0x80 | 20;
 #ifdef VERSION_EU
@@ -2409,6 +2646,7 @@ void play_star_fanfare(void) {
 }
 
 void play_power_star_jingle(u8 arg0) {
+    DEFER_AUDIO_COMMAND(play_power_star_jingle, arg0, 0, 0, 0);
     if (!arg0) {
         D_80363812 = 0;
     }
@@ -2421,6 +2659,7 @@ void play_power_star_jingle(u8 arg0) {
 }
 
 void play_race_fanfare(void) {
+    DEFER_AUDIO_COMMAND(play_race_fanfare, 0, 0, 0, 0);
     play_sequence(SEQ_PLAYER_ENV, SEQ_EVENT_RACE, 0);
     D_8033211C = 0x80 | 20;
 #ifdef VERSION_EU
@@ -2430,6 +2669,7 @@ void play_race_fanfare(void) {
 }
 
 void play_toads_jingle(void) {
+    DEFER_AUDIO_COMMAND(play_toads_jingle, 0, 0, 0, 0);
     play_sequence(SEQ_PLAYER_ENV, SEQ_EVENT_TOAD_MESSAGE, 0);
     D_8033211C = 0x80 | 20;
 #ifdef VERSION_EU
@@ -2439,6 +2679,7 @@ void play_toads_jingle(void) {
 }
 
 void sound_reset(u8 presetId) {
+    DEFER_AUDIO_COMMAND(sound_reset, presetId, 0, 0, 0);
 #ifndef VERSION_JP
     if (presetId >= 8) {
         presetId = 0;
@@ -2466,6 +2707,7 @@ void sound_reset(u8 presetId) {
 }
 
 void audio_set_sound_mode(u8 soundMode) {
+    DEFER_AUDIO_COMMAND(audio_set_sound_mode, soundMode, 0, 0, 0);
     D_80332108 = (D_80332108 & 0xf) + (soundMode << 4);
     gSoundMode = soundMode;
 }
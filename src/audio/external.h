@@ -59,6 +59,13 @@ void audio_set_sound_mode(u8 arg0);
 
 void audio_init(void); // in load.c
 
+#ifndef TARGET_N64
+#define REVERB_MODE_N64 0 // the ring buffer of the N64
+#define REVERB_MODE_FDN 1 // a feedback delay network, denser and smoother
+
+extern u8 gReverbMode; // in synthesis.c, set before audio_init
+#endif
+
 #ifdef VERSION_EU
 struct SPTask *unused_80321460(void);
 #endif
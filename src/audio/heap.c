@@ -7,8 +7,22 @@
 #include "seqplayer.h"
 #include "effects.h"
 
+#ifndef TARGET_N64
+#include "../pc/audio/audio_api.h"
+#endif
+
 #define ALIGN16(val) (((val) + 0xF) & ~0xF)
 
+#ifndef TARGET_N64
+// The presets are made for 32 kHz, while PC synthesizes at the output rate of the audio backend
+#define AT_OUTPUT_RATE(n) ALIGN16(AUDIO_FRAMES_AT_OUTPUT_RATE(n))
+#ifdef VERSION_EU
+#define UPDATES_PER_FRAME_AT_32KHZ 5
+#else
+#define UPDATES_PER_FRAME_AT_32KHZ 4
+#endif
+#endif
+
 struct PoolSplit {
     u32 wantSeq;
     u32 wantBank;
@@ -153,10 +167,20 @@ void reset_bank_and_seq_load_status(void) {
 
     for (i = 0; i < 64; i++) {
         gBankLoadStatus[i] = SOUND_LOAD_STATUS_NOT_LOADED;
+#ifdef RESIDENT_SOUND_DATA
+        if (get_resident_bank(i) != NULL) {
+            gBankLoadStatus[i] = SOUND_LOAD_STATUS_COMPLETE;
+        }
+#endif
     }
 
     for (i = 0; i < 256; i++) {
         gSeqLoadStatus[i] = SOUND_LOAD_STATUS_NOT_LOADED;
+#ifdef RESIDENT_SOUND_DATA
+        if (get_resident_sequence(i) != NULL) {
+            gSeqLoadStatus[i] = SOUND_LOAD_STATUS_COMPLETE;
+        }
+#endif
     }
 }
 
@@ -514,6 +538,15 @@ void *get_bank_or_seq(struct SoundMultiPool *arg0, s32 arg1, s32 id) {
     UNUSED void *ret;
     struct TemporaryPool *temporary = &arg0->temporary;
 
+#ifdef RESIDENT_SOUND_DATA
+    if (arg0 == &gBankLoadedPool && get_resident_bank(id) != NULL) {
+        return get_resident_bank(id);
+    }
+    if (arg0 == &gSeqLoadedPool && get_resident_sequence(id) != NULL) {
+        return get_resident_sequence(id);
+    }
+#endif
+
     if (arg1 == 0) {
         // Try not to overwrite sound that we have just accessed, by setting nextSide appropriately.
         if (temporary->entries[0].id == id) {
@@ -746,7 +779,11 @@ void audio_reset_session(void) {
 
     gSampleDmaNumListItems = 0;
 #ifdef VERSION_EU
+#ifdef TARGET_N64
     gAudioBufferParameters.frequency = preset->frequency;
+#else
+    gAudioBufferParameters.frequency = audio_output_frequency;
+#endif
     gAudioBufferParameters.aiFrequency = osAiSetFrequency(gAudioBufferParameters.frequency);
     gAudioBufferParameters.samplesPerFrameTarget = ALIGN16(gAudioBufferParameters.frequency / gRefreshRate);
     gAudioBufferParameters.minAiBufferLength = gAudioBufferParameters.samplesPerFrameTarget - 0x10;
@@ -758,6 +795,9 @@ void audio_reset_session(void) {
     gAudioBufferParameters.resampleRate = 32000.0f / FLOAT_CAST(gAudioBufferParameters.frequency);
     gAudioBufferParameters.unkUpdatesPerFrameScaled = (3.0f / 1280.0f) / gAudioBufferParameters.updatesPerFrame;
     gAudioBufferParameters.updatesPerFrameInv = 1.0f / gAudioBufferParameters.updatesPerFrame;
+#ifndef TARGET_N64
+    gAudioUpdateRateScale = (f32) gAudioBufferParameters.updatesPerFrame / UPDATES_PER_FRAME_AT_32KHZ;
+#endif
 
     gMaxSimultaneousNotes = preset->maxSimultaneousNotes;
     gVolume = preset->volume;
@@ -771,8 +811,15 @@ void audio_reset_session(void) {
 
     gMaxAudioCmds = gMaxSimultaneousNotes * 0x10 * gAudioBufferParameters.updatesPerFrame + preset->numReverbs * 0x20 + 0x300;
 #else
+#ifdef TARGET_N64
     reverbWindowSize = preset->reverbWindowSize;
     gAiFrequency = osAiSetFrequency(preset->frequency);
+#else
+    // Reverb delays are in samples too
+    reverbWindowSize = AT_OUTPUT_RATE(preset->reverbWindowSize);
+    // Keep the N64's rounded AI rate at 32 kHz, which playback treats as exactly 32 kHz
+    gAiFrequency = audio_output_frequency == 32000 ? osAiSetFrequency(32000) : (s32) audio_output_frequency;
+#endif
     gMaxSimultaneousNotes = preset->maxSimultaneousNotes;
     gSamplesPerFrameTarget = ALIGN16(gAiFrequency / 60);
     gReverbDownsampleRate = preset->reverbDownsampleRate;
@@ -802,6 +849,9 @@ void audio_reset_session(void) {
     gMinAiBufferLength = gSamplesPerFrameTarget - 0x10;
     updatesPerFrame = gSamplesPerFrameTarget / 160 + 1;
     gAudioUpdatesPerFrame = gSamplesPerFrameTarget / 160 + 1;
+#ifndef TARGET_N64
+    gAudioUpdateRateScale = (f32) gAudioUpdatesPerFrame / UPDATES_PER_FRAME_AT_32KHZ;
+#endif
 
     // Compute conversion ratio from the internal unit tatums/tick to the
     // external beats/minute (JP) or tatums/minute (US). In practice this is
@@ -864,6 +914,9 @@ void audio_reset_session(void) {
         reverb = &gSynthesisReverbs[j];
         reverbSettings = &preset->reverbSettings[j];
         reverb->windowSize = reverbSettings->windowSize * 64;
+#ifndef TARGET_N64
+        reverb->windowSize = AT_OUTPUT_RATE(reverb->windowSize);
+#endif
         reverb->downsampleRate = reverbSettings->downsampleRate;
         reverb->reverbGain = reverbSettings->gain;
         reverb->useReverb = 8;
@@ -924,6 +977,10 @@ void audio_reset_session(void) {
     }
 #endif
 
+#ifndef TARGET_N64
+    synthesis_reset_reverb_fdns();
+#endif
+
     init_sample_dma_buffers(gMaxSimultaneousNotes);
 
 #ifdef VERSION_EU
@@ -63,6 +63,7 @@ extern u8 gAudioResetPresetIdToLoad;
 void *soundAlloc(struct SoundAllocPool *pool, u32 size);
 void sound_init_main_pools(s32 sizeForAudioInitPool);
 void *alloc_bank_or_seq(struct SoundMultiPool *arg0, s32 arg1, s32 size, s32 arg3, s32 id);
+void reset_bank_and_seq_load_status(void);
 void *get_bank_or_seq(struct SoundMultiPool *arg0, s32 arg1, s32 arg2);
 #ifdef VERSION_EU
 s32 audio_shut_down_and_reset_step(void);
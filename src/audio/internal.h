@@ -200,6 +200,9 @@ struct M64ScriptState {
     u8 *stack[4];
     u8 remLoopIters[4];
     u8 depth;
+#ifndef TARGET_N64
+    u16 *args; // pre-decoded operands of the current command, see m64_fetch
+#endif
 }; // size = 0x1C
 
 struct SequencePlayer
@@ -1,4 +1,7 @@
 #include <ultra64.h>
+#ifndef TARGET_N64
+#include <stdlib.h>
+#endif
 
 #include "data.h"
 #include "external.h"
@@ -8,6 +11,12 @@
 
 #define ALIGN16(val) (((val) + 0xF) & ~0xF)
 
+#ifndef TARGET_N64
+// All sample data is in memory on PC, so notes read it in place instead of
+// through emulated cartridge DMAs into sSampleDmas buffers
+#define DIRECT_SAMPLE_ACCESS
+#endif
+
 struct SharedDma {
     /*0x0*/ u8 *buffer;       // target, points to pre-allocated buffer
     /*0x4*/ uintptr_t source; // device address
@@ -94,6 +103,11 @@ s8 gSoundMode;
 s8 gAudioUpdatesPerFrame;
 #endif
 
+#ifndef TARGET_N64
+// Audio updates per frame relative to 32 kHz output, so per-update modulation can keep its speed
+f32 gAudioUpdateRateScale = 1.0f;
+#endif
+
 extern u64 gAudioGlobalsStartMarker;
 extern u64 gAudioGlobalsEndMarker;
 
@@ -138,6 +152,19 @@ void audio_dma_partial_copy_async(uintptr_t *devAddr, u8 **vAddr, ssize_t *remai
     *vAddr += transfer;
 }
 
+#ifdef DIRECT_SAMPLE_ACCESS
+void decrease_sample_dma_ttls() {
+}
+
+void *dma_sample_data(uintptr_t devAddr, UNUSED u32 size, UNUSED s32 arg2, UNUSED u8 *arg3) {
+    return (void *) devAddr;
+}
+
+void init_sample_dma_buffers(UNUSED s32 arg0) {
+    gSampleDmaNumListItems = 0;
+    sSampleDmaListSize1 = 0;
+}
+#else
 void decrease_sample_dma_ttls() {
     u32 i;
 
@@ -376,6 +403,7 @@ out2:
 #undef j
 #endif
 }
+#endif
 
 #ifndef static
 // Keep supporting the good old "#define static" hack.
@@ -405,7 +433,11 @@ void patch_sound(UNUSED struct AudioBankSound *sound, UNUSED u8 *memBase, UNUSED
 #ifdef VERSION_EU
         else if (sample->loaded == 0x80) {
             PATCH(sample->sampleAddr, offsetBase);
+#ifdef DIRECT_SAMPLE_ACCESS
+            mem = NULL; // no point in a resident copy, keep playing from the bank data
+#else
             mem = soundAlloc(&gNotesAndBuffersPool, sample->sampleSize);
+#endif
             if (mem == NULL) {
                 sample->sampleAddr = patched;
                 sample->loaded = 1;
@@ -695,6 +727,72 @@ void *sequence_dma_async(s32 seqId, s32 arg1, struct SequencePlayer *seqPlayer)
     return ptr;
 }
 
+#ifdef RESIDENT_SOUND_DATA
+static struct AudioBank *sResidentBanks[ARRAY_COUNT(gBankLoadStatus)];
+static void *sResidentSequences[ARRAY_COUNT(gSeqLoadStatus)];
+
+struct AudioBank *get_resident_bank(s32 bankId) {
+    return (u32) bankId < ARRAY_COUNT(sResidentBanks) ? sResidentBanks[bankId] : NULL;
+}
+
+void *get_resident_sequence(s32 seqId) {
+    return (u32) seqId < ARRAY_COUNT(sResidentSequences) ? sResidentSequences[seqId] : NULL;
+}
+
+/**
+ * Copies and patches every bank and sequence once into a single arena. They
+ * stay there for good, so session resets on level changes discard nothing and
+ * starting a sequence never has to load or evict anything from the pools.
+ * If the arena can't be allocated, everything loads through the pools as usual.
+ */
+static void load_resident_sound_data(void) {
+    u32 numBanks = gAlCtlHeader->seqCount;
+    u32 numSequences = gSequenceCount;
+    u32 buf[4];
+    size_t size = 0;
+    u8 *mem;
+    u32 i;
+
+    // Same sizes as bank_load_immediate and sequence_dma_immediate
+    for (i = 0; i < numBanks; i++) {
+        size += ALIGN16(gAlCtlHeader->seqArray[i].len + 0xf) - 0x10;
+    }
+    for (i = 0; i < numSequences; i++) {
+        size += ALIGN16(gSeqFileHeader->seqArray[i].len + 0xf);
+    }
+    if (numBanks > ARRAY_COUNT(sResidentBanks) || numSequences > ARRAY_COUNT(sResidentSequences)
+        || (mem = malloc(size)) == NULL) {
+        return;
+    }
+
+    for (i = 0; i < numBanks; i++) {
+        u8 *ctlData = gAlCtlHeader->seqArray[i].offset;
+        s32 alloc = ALIGN16(gAlCtlHeader->seqArray[i].len + 0xf) - 0x10;
+        struct AudioBank *bank = (struct AudioBank *) mem;
+
+        audio_dma_copy_immediate((uintptr_t) ctlData, buf, 0x10);
+        audio_dma_copy_immediate((uintptr_t)(ctlData + 0x10), bank, alloc);
+        patch_audio_bank(bank, gAlTbl->seqArray[i].offset, buf[0], buf[1]);
+        gCtlEntries[i].numInstruments = (u8) buf[0];
+        gCtlEntries[i].numDrums = (u8) buf[1];
+        gCtlEntries[i].instruments = bank->instruments;
+        gCtlEntries[i].drums = bank->drums;
+        sResidentBanks[i] = bank;
+        mem += alloc;
+    }
+
+    for (i = 0; i < numSequences; i++) {
+        s32 seqLength = ALIGN16(gSeqFileHeader->seqArray[i].len + 0xf);
+
+        audio_dma_copy_immediate((uintptr_t) gSeqFileHeader->seqArray[i].offset, mem, seqLength);
+        sResidentSequences[i] = mem;
+        mem += seqLength;
+    }
+
+    reset_bank_and_seq_load_status();
+}
+#endif
+
 u8 get_missing_bank(u32 seqId, s32 *nonNullCount, s32 *nullCount) {
     void *temp;
     u32 bankId;
@@ -866,6 +964,9 @@ void load_sequence_internal(u32 player, u32 seqId, s32 loadAsync) {
     seqPlayer->enabled = TRUE;
     seqPlayer->seqData = sequenceData;
     seqPlayer->scriptState.pc = sequenceData;
+#ifdef M64_PREDECODE
+    m64_predecode_reset(seqPlayer, gSeqFileHeader->seqArray[seqId].len);
+#endif
 }
 
 // (void) must be omitted from parameters
@@ -1009,6 +1110,10 @@ void audio_init() {
     gAlBankSets = soundAlloc(&gAudioInitPool, 0x100);
     audio_dma_copy_immediate((uintptr_t) gBankSetsData, gAlBankSets, 0x100);
 
+#ifdef RESIDENT_SOUND_DATA
+    load_resident_sound_data();
+#endif
+
     init_sequence_players();
     gAudioLoadLock = AUDIO_LOCK_NOT_LOADING;
 }
@@ -10,6 +10,11 @@
 #define PRELOAD_BANKS 2
 #define PRELOAD_SEQUENCE 1
 
+#ifndef TARGET_N64
+// Every bank and sequence is loaded once at startup instead of through the session pools
+#define RESIDENT_SOUND_DATA
+#endif
+
 #define IS_SEQUENCE_CHANNEL_VALID(ptr) ((uintptr_t)(ptr) != (uintptr_t)&gSequenceChannelNone)
 
 extern struct Note *gNotes;
@@ -47,6 +52,9 @@ extern s32 gMinAiBufferLength;
 extern s16 gTempoInternalToExternal;
 extern s8 gAudioUpdatesPerFrame; // = 4
 extern s8 gSoundMode;
+#ifndef TARGET_N64
+extern f32 gAudioUpdateRateScale;
+#endif
 
 void audio_dma_partial_copy_async(uintptr_t *devAddr, u8 **vAddr, ssize_t *remaining, OSMesgQueue *queue, OSIoMesg *mesg);
 void decrease_sample_dma_ttls(void);
@@ -55,5 +63,9 @@ void init_sample_dma_buffers(s32 arg0);
 void patch_audio_bank(struct AudioBank *mem, u8 *offset, u32 numInstruments, u32 numDrums);
 void preload_sequence(u32 seqId, u8 preloadMask);
 void load_sequence(u32 player, u32 seqId, s32 loadAsync);
+#ifdef RESIDENT_SOUND_DATA
+struct AudioBank *get_resident_bank(s32 bankId);
+void *get_resident_sequence(s32 seqId);
+#endif
 
 #endif // AUDIO_LOAD_H
@@ -19,7 +19,7 @@
 #define PORTAMENTO_MODE_5 5
 
 #define COPT 0
-#if COPT
+#if COPT || defined(M64_PREDECODE)
 #define M64_READ_U8(state, dst) \
     dst = m64_read_u8(state);
 #else
@@ -35,7 +35,7 @@
 #endif
 
 
-#if COPT
+#if COPT || defined(M64_PREDECODE)
 #define M64_READ_S16(state, dst) \
     dst = m64_read_s16(state);
 #else
@@ -49,7 +49,7 @@
     dst = _ret;                     \
 }
 #endif
-#if COPT
+#if COPT || defined(M64_PREDECODE)
 #define M64_READ_COMPRESSED_U16(state, dst) \
     dst = m64_read_compressed_u16(state);
 #else
@@ -199,6 +199,10 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
         state = &layer->scriptState;
         //M64_READ_U8(state, cmd);
         // manually inlined because we need _Kqi6 :(
+#ifdef M64_PREDECODE
+        _Kqi6 = m64_fetch(seqPlayer, state, seqChannel->largeNotes ? M64_SCRIPT_LAYER_LARGE_NOTES : M64_SCRIPT_LAYER);
+        cmd = _Kqi6;
+#else
         {
             u8 *_ptr_pc;
             _ptr_pc = (*state).pc;
@@ -208,6 +212,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
             _Kqi6 = *_ptr_pc;
             cmd = _Kqi6;
         }
+#endif
 
         if (cmd <= 0xc0) {
             break;
@@ -251,7 +256,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
 
             case 0xc1: // layer_setshortnotevelocity
             case 0xca: // layer_setpan
-                temp_a0_5 = *(state->pc++);
+                temp_a0_5 = M64_READ_RAW_U8(state);
                 if (cmd == 0xc1) {
                     layer->velocitySquare = (f32)(temp_a0_5 * temp_a0_5);
                 } else {
@@ -261,7 +266,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
 
             case 0xc2: // layer_transpose; set transposition in semitones
             case 0xc9: // layer_setshortnoteduration
-                temp_a0_6 = *(state->pc++);
+                temp_a0_6 = M64_READ_RAW_U8(state);
                 if (cmd == 0xc9) {
                     layer->noteDuration = temp_a0_6;
                 } else {
@@ -305,7 +310,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
 
                 // If special, the next param is u8 instead of var
                 if (PORTAMENTO_IS_SPECIAL((*(layer)).portamento)) {
-                    layer->portamentoTime = *((state)->pc++);
+                    layer->portamentoTime = M64_READ_RAW_U8(state);
                     break;
                 }
 
@@ -340,14 +345,14 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
             switch (cmd & 0xc0) {
                 case 0x00: // layer_note0 (play percentage, velocity, duration)
                     M64_READ_COMPRESSED_U16(state, sp3A)
-                    vel = *((*state).pc++);
-                    layer->noteDuration = *(state->pc++);
+                    vel = M64_READ_RAW_U8(state);
+                    layer->noteDuration = M64_READ_RAW_U8(state);
                     layer->playPercentage = sp3A;
                     goto l1090;
 
                 case 0x40: // layer_note1 (play percentage, velocity)
                     M64_READ_COMPRESSED_U16(state, sp3A)
-                    vel = *(state->pc++);
+                    vel = M64_READ_RAW_U8(state);
                     layer->noteDuration = 0;
                     layer->playPercentage = sp3A;
                     goto l1090;
@@ -355,8 +360,8 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
                     
                 case 0x80: // layer_note2 (velocity, duration; uses last play percentage)
                     sp3A = layer->playPercentage;
-                    vel = *(state->pc++);
-                    layer->noteDuration = *(state->pc++);
+                    vel = M64_READ_RAW_U8(state);
+                    layer->noteDuration = M64_READ_RAW_U8(state);
                     goto l1090;
             }
 l1090:
@@ -1,4 +1,8 @@
 #include <PR/ultratypes.h>
+#ifndef TARGET_N64
+#include <stdlib.h>
+#include <string.h>
+#endif
 
 #include "data.h"
 #include "effects.h"
@@ -354,6 +358,11 @@ void init_layer_freelist(void) {
 }
 
 u8 m64_read_u8(struct M64ScriptState *state) {
+#ifdef M64_PREDECODE
+    if (state->args != NULL) {
+        return *state->args++;
+    }
+#endif
 #ifdef VERSION_EU
     return *(state->pc++);
 #else
@@ -363,12 +372,22 @@ u8 m64_read_u8(struct M64ScriptState *state) {
 }
 
 s16 m64_read_s16(struct M64ScriptState *state) {
+#ifdef M64_PREDECODE
+    if (state->args != NULL) {
+        return *state->args++;
+    }
+#endif
     s16 ret = *(state->pc++) << 8;
     ret = *(state->pc++) | ret;
     return ret;
 }
 
 u16 m64_read_compressed_u16(struct M64ScriptState *state) {
+#ifdef M64_PREDECODE
+    if (state->args != NULL) {
+        return *state->args++;
+    }
+#endif
     u16 ret = *(state->pc++);
     if (ret & 0x80) {
         ret = (ret << 8) & 0x7f00;
@@ -377,6 +396,260 @@ u16 m64_read_compressed_u16(struct M64ScriptState *state) {
     return ret;
 }
 
+#ifdef M64_PREDECODE
+// Operand bytes the interpreters read directly rather than through m64_read_u8
+#define M64_READ_RAW_U8(state) m64_read_u8(state)
+
+/*
+ * Commands of a sequence decoded into fixed-width records, one slot per byte
+ * offset so that any jump target, including ones from dynamic tables, finds
+ * its command. m64_fetch decodes a command the first time it runs, after
+ * which running it again just copies the length and hands the interpreter
+ * the operands it would otherwise parse from the bytecode one byte at a
+ * time. The m64_read_* functions take operands from the record while one is
+ * active, so the interpreters keep a single implementation.
+ *
+ * Operand layouts depend on the interpreter, and for layer notes on the
+ * channel's largeNotes flag, so records remember which they were decoded for.
+ */
+#define M64_SCRIPT_CHANNEL 1
+#define M64_SCRIPT_LAYER 2
+#define M64_SCRIPT_LAYER_LARGE_NOTES 3
+
+// chan_setvalues on EU takes the most operands
+#define M64_MAX_ARGS 8
+#define M64_MAX_COMMAND_LEN (1 + M64_MAX_ARGS)
+
+struct M64Command {
+    u8 script; // M64_SCRIPT_*, 0 if not decoded yet
+    u8 len;    // in bytes including the opcode, 0 to run from the bytecode
+    u16 args[M64_MAX_ARGS];
+};
+
+static struct M64CommandTable {
+    struct M64Command *commands;
+    u32 size;
+    u32 capacity;
+} sM64CommandTables[SEQUENCE_PLAYERS];
+
+/**
+ * Operands of a channel command, in the order sequence_channel_process_script reads them:
+ * b = u8, h = s16, v = compressed u16
+ */
+static const char *m64_channel_operands(u8 cmd) {
+    if (cmd <= 0xc0) {
+        switch (cmd & 0xf0) {
+            case 0x10: // chan_startchannel
+            case 0x90: // chan_setlayer
+                return "h";
+            case 0x30: // chan_iowriteval2
+            case 0x40: // chan_ioreadval2
+                return "b";
+        }
+        return "";
+    }
+
+    switch (cmd) {
+        case 0xfd: // chan_delay
+            return "v";
+        case 0xfc: // chan_call
+        case 0xfb: // chan_jump
+        case 0xfa: // chan_beqz
+        case 0xf9: // chan_bltz
+        case 0xf5: // chan_bgez
+        case 0xc2: // chan_setdyntable
+        case 0xde: // chan_freqscale
+        case 0xda: // chan_setenvelope
+        case 0xcb: // chan_readseq
+#ifdef VERSION_EU
+        case 0xe7:
+#endif
+            return "h";
+        case 0xf8: // chan_loop
+        case 0xc1: // chan_setinstr
+        case 0xdf: // chan_setvol
+        case 0xe0: // chan_setvolscale
+        case 0xd3: // chan_pitchbend
+        case 0xdd: // chan_setpan
+        case 0xdc: // chan_setpanmix
+        case 0xdb: // chan_transpose
+        case 0xd9: // chan_setdecayrelease
+        case 0xd8: // chan_setvibratoextent
+        case 0xd7: // chan_setvibratorate
+        case 0xe3: // chan_setvibratodelay
+        case 0xd4: // chan_setreverb
+        case 0xc6: // chan_setbank
+        case 0xc8: // chan_subtract
+        case 0xc9: // chan_bitand
+        case 0xcc: // chan_setval
+        case 0xca: // chan_setmutebhv
+        case 0xd0: // chan_stereoheadseteffects
+        case 0xd1: // chan_setnoteallocationpolicy
+        case 0xd2: // chan_setsustain
+#ifdef VERSION_EU
+        case 0xf4:
+        case 0xf3:
+        case 0xf2:
+        case 0xf1: // chan_reservenotes
+        case 0xe5:
+        case 0xe6:
+        case 0xe9:
+#else
+        case 0xf2: // chan_reservenotes
+        case 0xd6: // chan_setupdatesperframe_unimplemented
+#endif
+            return "b";
+#ifdef VERSION_EU
+        case 0xeb: // chan_setbank followed by chan_setinstr
+            return "bb";
+#endif
+        case 0xe2: // chan_setvibratoextentlinear
+        case 0xe1: // chan_setvibratoratelinear
+            return "bbb";
+        case 0xc7: // chan_writeseq
+            return "bh";
+#ifdef VERSION_EU
+        case 0xe8:
+            return "bbbbbbbb";
+#endif
+    }
+    return "";
+}
+
+/**
+ * Operands of a layer command, in the order seq_channel_layer_process_script reads them.
+ * Portamento is decoded by the caller, as its last operand depends on the first.
+ */
+static const char *m64_layer_operands(u8 cmd, s32 largeNotes) {
+    if (cmd == 0xc0) { // layer_delay
+        return "v";
+    }
+    if (cmd < 0xc0) {
+        switch (cmd & 0xc0) {
+            case 0x00: // layer_note0
+                return largeNotes ? "vbb" : "v";
+            case 0x40: // layer_note1
+                return largeNotes ? "vb" : "";
+            default: // layer_note2
+                return largeNotes ? "bb" : "";
+        }
+    }
+
+    switch (cmd) {
+        case 0xfc: // layer_call
+        case 0xfb: // layer_jump
+            return "h";
+        case 0xf8: // layer_loop
+        case 0xc1: // layer_setshortnotevelocity
+        case 0xca: // layer_setpan
+        case 0xc2: // layer_transpose
+        case 0xc9: // layer_setshortnoteduration
+        case 0xc6: // layer_setinstr
+#ifdef VERSION_EU
+        case 0xf4:
+#endif
+            return "b";
+        case 0xc3: // layer_setshortnotedefaultplaypercentage
+            return "v";
+#ifdef VERSION_EU
+        case 0xcb:
+            return "hb";
+#endif
+    }
+    return "";
+}
+
+static void m64_decode(struct M64Command *command, u8 *pc, u8 *end, u8 script) {
+    const char *operands;
+    u8 *start = pc;
+    u8 cmd = *pc++;
+    u16 value;
+    s32 numArgs = 0;
+
+    command->script = script;
+    command->len = 0;
+
+    if (script == M64_SCRIPT_CHANNEL) {
+        operands = m64_channel_operands(cmd);
+    } else if (cmd == 0xc7) { // layer_portamento: mode, note, then u8 time if special, else compressed
+        if (pc >= end) {
+            return;
+        }
+        operands = (pc[0] & 0x80) ? "bbb" : "bbv";
+    } else {
+        operands = m64_layer_operands(cmd, script == M64_SCRIPT_LAYER_LARGE_NOTES);
+    }
+
+    for (; *operands != '\0'; operands++) {
+        if (pc + (*operands == 'h') >= end) {
+            return; // runs past the end, leave it to the bytecode interpreter
+        }
+        value = *pc++;
+        if (*operands == 'h' || (*operands == 'v' && (value & 0x80))) {
+            if (pc >= end) {
+                return;
+            }
+            value = (*operands == 'h' ? value << 8 : (value << 8) & 0x7f00) | *pc++;
+        }
+        command->args[numArgs++] = value;
+    }
+    command->len = pc - start;
+}
+
+void m64_predecode_reset(struct SequencePlayer *seqPlayer, u32 size) {
+    struct M64CommandTable *table = &sM64CommandTables[seqPlayer - gSequencePlayers];
+
+    if (size > table->capacity) {
+        free(table->commands);
+        table->capacity = 0;
+        if ((table->commands = malloc(size * sizeof(struct M64Command))) != NULL) {
+            table->capacity = size;
+        }
+    }
+    table->size = size <= table->capacity ? size : 0;
+    if (table->size != 0) {
+        memset(table->commands, 0, table->size * sizeof(struct M64Command));
+    }
+}
+
+/**
+ * Reads the next command for the given interpreter, moving pc past its operands
+ * and making them available through the m64_read_* functions.
+ */
+static u8 m64_fetch(struct SequencePlayer *seqPlayer, struct M64ScriptState *state, u8 script) {
+    struct M64CommandTable *table = &sM64CommandTables[seqPlayer - gSequencePlayers];
+    uintptr_t offset = state->pc - seqPlayer->seqData;
+    u8 cmd = *state->pc;
+
+    state->args = NULL;
+    if (offset < table->size) {
+        struct M64Command *command = &table->commands[offset];
+        if (command->script != script) {
+            m64_decode(command, state->pc, seqPlayer->seqData + table->size, script);
+        }
+        if (command->len != 0) {
+            state->pc += command->len;
+            state->args = command->args;
+            return cmd;
+        }
+    }
+    state->pc++;
+    return cmd;
+}
+
+// Forgets the commands a write to the sequence data may have changed
+static void m64_predecode_invalidate(struct SequencePlayer *seqPlayer, u16 offset) {
+    struct M64CommandTable *table = &sM64CommandTables[seqPlayer - gSequencePlayers];
+    u32 i = offset >= M64_MAX_COMMAND_LEN ? offset - (M64_MAX_COMMAND_LEN - 1) : 0;
+
+    for (; i <= offset && i < table->size; i++) {
+        table->commands[i].script = 0;
+    }
+}
+#else
+#define M64_READ_RAW_U8(state) *((state)->pc++)
+#endif
+
 #if defined(VERSION_EU)
 void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
     struct SequencePlayer *seqPlayer;   // sp5C, t4
@@ -461,7 +734,11 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
 
     for (;;) {
         state = &layer->scriptState;
+#ifdef M64_PREDECODE
+        cmd = m64_fetch(seqPlayer, state, seqChannel->largeNotes ? M64_SCRIPT_LAYER_LARGE_NOTES : M64_SCRIPT_LAYER);
+#else
         cmd = m64_read_u8(state);
+#endif
 
         if (cmd <= 0xc0) {
             break;
@@ -510,7 +787,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
 
             case 0xc1: // layer_setshortnotevelocity
             case 0xca: // layer_setpan
-                temp_a0_5 = *(state->pc++);
+                temp_a0_5 = M64_READ_RAW_U8(state);
                 if (cmd == 0xc1) {
                     layer->velocitySquare = (f32)(temp_a0_5 * temp_a0_5);
                 } else {
@@ -524,7 +801,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
 
             case 0xc2: // layer_transpose; set transposition in semitones
             case 0xc9: // layer_setshortnoteduration
-                temp_a0_6 = *(state->pc++);
+                temp_a0_6 = M64_READ_RAW_U8(state);
                 if (cmd == 0xc9) {
                     layer->noteDuration = temp_a0_6;
                 } else {
@@ -594,7 +871,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
 
                 // If special, the next param is u8 instead of var
                 if (PORTAMENTO_IS_SPECIAL(layer->portamento)) {
-                    layer->portamentoTime = *((state)->pc++);
+                    layer->portamentoTime = M64_READ_RAW_U8(state);
                     break;
                 }
 
@@ -641,22 +918,22 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
             switch (cmd & 0xc0) {
                 case 0x00: // layer_note0 (play percentage, velocity, duration)
                     sp3A = m64_read_compressed_u16(state);
-                    vel = *(state->pc++);
-                    layer->noteDuration = *(state->pc++);
+                    vel = M64_READ_RAW_U8(state);
+                    layer->noteDuration = M64_READ_RAW_U8(state);
                     layer->playPercentage = sp3A;
                     break;
 
                 case 0x40: // layer_note1 (play percentage, velocity)
                     sp3A = m64_read_compressed_u16(state);
-                    vel = *(state->pc++);
+                    vel = M64_READ_RAW_U8(state);
                     layer->noteDuration = 0;
                     layer->playPercentage = sp3A;
                     break;
 
                 case 0x80: // layer_note2 (velocity, duration; uses last play percentage)
                     sp3A = layer->playPercentage;
-                    vel = *(state->pc++);
-                    layer->noteDuration = *(state->pc++);
+                    vel = M64_READ_RAW_U8(state);
+                    layer->noteDuration = M64_READ_RAW_U8(state);
                     break;
             }
 
@@ -1030,7 +1307,11 @@ void sequence_channel_process_script(struct SequenceChannel *seqChannel) {
     state = &seqChannel->scriptState;
     if (seqChannel->delay == 0) {
         for (;;) {
+#ifdef M64_PREDECODE
+            cmd = m64_fetch(seqPlayer, state, M64_SCRIPT_CHANNEL);
+#else
             cmd = m64_read_u8(state);
+#endif
 #ifndef VERSION_EU
             if (cmd == 0xff) // chan_end
             {
@@ -1254,8 +1535,7 @@ void sequence_channel_process_script(struct SequenceChannel *seqChannel) {
                         break;
 
                     case 0xdb: // chan_transpose; set transposition in semitones
-                        tempSigned = *state->pc;
-                        state->pc++;
+                        tempSigned = M64_READ_RAW_U8(state);
                         seqChannel->transposition = tempSigned;
                         break;
 
@@ -1333,7 +1613,13 @@ void sequence_channel_process_script(struct SequenceChannel *seqChannel) {
                         u8 temp;
                         sp38 = value;
                         temp = m64_read_u8(state);
+#ifdef M64_PREDECODE
+                        sp5A = m64_read_s16(state);
+                        seqPlayer->seqData[sp5A] = sp38 + temp;
+                        m64_predecode_invalidate(seqPlayer, sp5A);
+#else
                         seqPlayer->seqData[(u16)m64_read_s16(state)] = sp38 + temp;
+#endif
                         }
                         break;
 
@@ -6,6 +6,11 @@
 #include "internal.h"
 #include "playback.h"
 
+#ifndef TARGET_N64
+// Channel and layer scripts run from commands decoded once per sequence instead of raw bytecode
+#define M64_PREDECODE
+#endif
+
 void seq_channel_layer_disable(struct SequenceChannelLayer *seqPlayer);
 void sequence_channel_disable(struct SequenceChannel *seqPlayer);
 void sequence_player_disable(struct SequencePlayer* seqPlayer);
@@ -14,5 +19,8 @@ void *audio_list_pop_back(struct AudioListItem *list);
 void process_sequences(s32 iterationsRemaining);
 void init_sequence_player(u32 player);
 void init_sequence_players(void);
+#ifdef M64_PREDECODE
+void m64_predecode_reset(struct SequencePlayer *seqPlayer, u32 size);
+#endif
 
 #endif // AUDIO_SEQPLAYER_H
@@ -9,6 +9,14 @@
 
 #ifndef TARGET_N64
 #include "../pc/mixer.h"
+#include "../pc/audio/audio_workers.h"
+
+#ifdef AUDIO_WORKERS
+// Notes can be rendered on the audio worker threads, see synthesis_run_note_job
+#define PARALLEL_NOTE_SYNTHESIS
+// Waking the workers costs more than rendering fewer notes than this on each of them
+#define MIN_NOTES_PER_WORKER 4
+#endif
 #endif
 
 #define DMEM_ADDR_TEMP 0x0
@@ -52,6 +60,10 @@ u64 *load_wave_samples(u64 *cmd, struct NoteSubEu *noteSubEu, struct NoteSynthes
 u64 *final_resample(u64 *cmd, struct NoteSynthesisState *synthesisState, s32 count, u16 pitch, u16 dmemIn, u32 flags);
 u64 *process_envelope(u64 *cmd, struct NoteSubEu *noteSubEu, struct NoteSynthesisState *synthesisState, s32 nSamples, u16 inBuf, s32 headsetPanSettings, u32 flags);
 u64 *note_apply_headset_pan_effects(u64 *cmd, struct NoteSubEu *noteSubEu, struct NoteSynthesisState *note, s32 bufLen, s32 flags, s32 leftRight);
+#ifdef PARALLEL_NOTE_SYNTHESIS
+u64 *synthesis_process_note_list(const u8 *noteIndices, s32 first, s32 last, s32 checkBankLoad, u32 updateIndex,
+                                 s32 bufLen, u64 *cmd);
+#endif
 #else
 u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd);
 u64 *load_wave_samples(u64 *cmd, struct Note *note, s32 nSamplesToLoad);
@@ -82,14 +94,59 @@ struct SynthesisReverb gSynthesisReverb;
 u8 sAudioSynthesisPad[0x20];
 #endif
 
+#ifndef TARGET_N64
+u8 gReverbMode = REVERB_MODE_N64;
+
+static struct {
+    struct ReverbFDN fdn;
+    u8 ready; // set up for the current audio session
+} sReverbFDNs[4];
+
+// Called by audio_reset_session, whose reverb sizes and rate may differ from the last session
+void synthesis_reset_reverb_fdns(void) {
+    s32 i;
+
+    for (i = 0; i < 4; i++) {
+        sReverbFDNs[i].ready = FALSE;
+    }
+}
+
+// The high quality reverb: instead of going through the ring buffer, the wet buses run through
+// a feedback delay network as long as the ring buffer and with the same decay, straight into
+// the dry buses.
+static u64 *synthesis_reverb_fdn(u64 *cmd, s32 reverbIndex, s32 bufLen) {
+#ifdef VERSION_EU
+    struct SynthesisReverb *reverb = &gSynthesisReverbs[reverbIndex];
+    s32 delay = reverb->bufSizePerChannel * reverb->downsampleRate;
+    s32 rate = gAudioBufferParameters.frequency;
+#else
+    struct SynthesisReverb *reverb = &gSynthesisReverb;
+    s32 delay = reverb->bufSizePerChannel * gReverbDownsampleRate;
+    s32 rate = gAiFrequency;
+#endif
+
+    // Start from silence in a new audio session, like its freshly allocated ring buffer
+    if (!sReverbFDNs[reverbIndex].ready) {
+        sReverbFDNs[reverbIndex].ready = TRUE;
+        mixer_reverb_fdn_init(&sReverbFDNs[reverbIndex].fdn, delay, rate);
+    }
+    aSetBuffer(cmd++, 0, 0, DMEM_ADDR_LEFT_CH, bufLen * 2);
+    aSetBuffer(cmd++, A_AUX, DMEM_ADDR_RIGHT_CH, DMEM_ADDR_WET_LEFT_CH, DMEM_ADDR_WET_RIGHT_CH);
+    aReverbFDN(cmd++, &sReverbFDNs[reverbIndex].fdn, reverb->reverbGain);
+    return cmd;
+}
+#endif
+
 #if defined(VERSION_EU)
 // Equivalent functionality as the US/JP version,
 // just that the reverb structure is chosen from an array with index
 void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex, s32 reverbIndex) {
     struct ReverbRingBufferItem *item;
     struct SynthesisReverb *reverb = &gSynthesisReverbs[reverbIndex];
+#ifdef TARGET_N64
     s32 srcPos;
     s32 dstPos;
+#endif
     s32 nSamples;
     s32 excessiveSamples;
     s32 UNUSED pad[3];
@@ -102,6 +159,7 @@ void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex, s32 reverbIndex)
             // Touches both left and right since they are adjacent in memory
             osInvalDCache(item->toDownsampleLeft, DEFAULT_LEN_2CH);
 
+#ifdef TARGET_N64
             for (srcPos = 0, dstPos = 0; dstPos < item->lengthA / 2;
                  srcPos += reverb->downsampleRate, dstPos++) {
                 reverb->ringBuffer.left[item->startPos + dstPos] =
@@ -113,6 +171,16 @@ void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex, s32 reverbIndex)
                 reverb->ringBuffer.left[dstPos] = item->toDownsampleLeft[srcPos];
                 reverb->ringBuffer.right[dstPos] = item->toDownsampleRight[srcPos];
             }
+#else
+            mixer_downsample(&reverb->ringBuffer.left[item->startPos], item->toDownsampleLeft,
+                             item->lengthA / 2, reverb->downsampleRate);
+            mixer_downsample(&reverb->ringBuffer.right[item->startPos], item->toDownsampleRight,
+                             item->lengthA / 2, reverb->downsampleRate);
+            mixer_downsample(reverb->ringBuffer.left, item->toDownsampleLeft + item->lengthA / 2 * reverb->downsampleRate,
+                             item->lengthB / 2, reverb->downsampleRate);
+            mixer_downsample(reverb->ringBuffer.right, item->toDownsampleRight + item->lengthA / 2 * reverb->downsampleRate,
+                             item->lengthB / 2, reverb->downsampleRate);
+#endif
         }
     }
 
@@ -139,8 +207,10 @@ void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex, s32 reverbIndex)
 #else
 void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex) {
     struct ReverbRingBufferItem *item;
+#ifdef TARGET_N64
     s32 srcPos;
     s32 dstPos;
+#endif
     s32 nSamples;
     s32 numSamplesAfterDownsampling;
     s32 excessiveSamples;
@@ -153,6 +223,7 @@ void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex) {
             // Touches both left and right since they are adjacent in memory
             osInvalDCache(item->toDownsampleLeft, DEFAULT_LEN_2CH);
 
+#ifdef TARGET_N64
             for (srcPos = 0, dstPos = 0; dstPos < item->lengthA / 2;
                  srcPos += gReverbDownsampleRate, dstPos++) {
                 gSynthesisReverb.ringBuffer.left[dstPos + item->startPos] =
@@ -164,6 +235,16 @@ void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex) {
                 gSynthesisReverb.ringBuffer.left[dstPos] = item->toDownsampleLeft[srcPos];
                 gSynthesisReverb.ringBuffer.right[dstPos] = item->toDownsampleRight[srcPos];
             }
+#else
+            mixer_downsample(&gSynthesisReverb.ringBuffer.left[item->startPos], item->toDownsampleLeft,
+                             item->lengthA / 2, gReverbDownsampleRate);
+            mixer_downsample(&gSynthesisReverb.ringBuffer.right[item->startPos], item->toDownsampleRight,
+                             item->lengthA / 2, gReverbDownsampleRate);
+            mixer_downsample(gSynthesisReverb.ringBuffer.left, item->toDownsampleLeft + item->lengthA / 2 * gReverbDownsampleRate,
+                             item->lengthB / 2, gReverbDownsampleRate);
+            mixer_downsample(gSynthesisReverb.ringBuffer.right, item->toDownsampleRight + item->lengthA / 2 * gReverbDownsampleRate,
+                             item->lengthB / 2, gReverbDownsampleRate);
+#endif
         }
     }
     item = &gSynthesisReverb.items[gSynthesisReverb.curFrame][updateIndex];
@@ -357,6 +438,12 @@ u64 *synthesis_resample_and_mix_reverb(u64 *cmd, s32 bufLen, s16 reverbIndex, s1
     item = &gSynthesisReverbs[reverbIndex].items[gSynthesisReverbs[reverbIndex].curFrame][updateIndex];
 
     aClearBuffer(cmd++, DMEM_ADDR_WET_LEFT_CH, DEFAULT_LEN_2CH);
+#ifndef TARGET_N64
+    if (gReverbMode == REVERB_MODE_FDN) {
+        // The wet buses only collect the sends of the notes, see synthesis_reverb_fdn
+        return cmd;
+    }
+#endif
     if (gSynthesisReverbs[reverbIndex].downsampleRate == 1) {
         cmd = synthesis_load_reverb_ring_buffer(cmd, DMEM_ADDR_WET_LEFT_CH, item->startPos, item->lengthA, reverbIndex);
         if (item->lengthB != 0) {
@@ -425,6 +512,9 @@ u64 *synthesis_do_one_audio_update(s16 *aiBuf, s32 bufLen, u64 *cmd, u32 updateI
     s32 i;
     s16 j;
     s16 notePos = 0;
+#ifdef PARALLEL_NOTE_SYNTHESIS
+    s32 notesEnd;
+#endif
 
     if (gNumSynthesisReverbs == 0) {
         for (i = 0; i < gMaxSimultaneousNotes; i++) {
@@ -459,6 +549,15 @@ u64 *synthesis_do_one_audio_update(s16 *aiBuf, s32 bufLen, u64 *cmd, u32 updateI
         if (gUseReverb != 0) {
             cmd = synthesis_resample_and_mix_reverb(cmd, bufLen, j, updateIndex);
         }
+#ifdef PARALLEL_NOTE_SYNTHESIS
+        for (notesEnd = i; notesEnd < notePos; notesEnd++) {
+            if (j != gNoteSubsEu[updateIndex * gMaxSimultaneousNotes + noteIndices[notesEnd]].reverbIndex) {
+                break;
+            }
+        }
+        cmd = synthesis_process_note_list(noteIndices, i, notesEnd, FALSE, updateIndex, bufLen, cmd);
+        i = notesEnd;
+#else
         for (; i < notePos; i++) {
             temp = updateIndex;
             temp *= gMaxSimultaneousNotes;
@@ -472,10 +571,19 @@ u64 *synthesis_do_one_audio_update(s16 *aiBuf, s32 bufLen, u64 *cmd, u32 updateI
                 break;
             }
         }
+#endif
+#ifndef TARGET_N64
+        if (gSynthesisReverbs[j].useReverb != 0 && gReverbMode == REVERB_MODE_FDN) {
+            cmd = synthesis_reverb_fdn(cmd, j, bufLen);
+        } else
+#endif
         if (gSynthesisReverbs[j].useReverb != 0) {
             cmd = synthesis_save_reverb_samples(cmd, j, updateIndex);
         }
     }
+#ifdef PARALLEL_NOTE_SYNTHESIS
+    cmd = synthesis_process_note_list(noteIndices, i, notePos, TRUE, updateIndex, bufLen, cmd);
+#else
     for (; i < notePos; i++) {
         temp = updateIndex;
         temp *= gMaxSimultaneousNotes;
@@ -488,12 +596,17 @@ u64 *synthesis_do_one_audio_update(s16 *aiBuf, s32 bufLen, u64 *cmd, u32 updateI
             gAudioErrorFlags = (gNoteSubsEu[temp + noteIndices[i]].bankId + (i << 8)) + 0x10000000;
         }
     }
+#endif
 
     temp = bufLen * 2;
     aSetBuffer(cmd++, 0, 0, DMEM_ADDR_TEMP, temp);
+#ifdef TARGET_N64
     aInterleave(cmd++, DMEM_ADDR_LEFT_CH, DMEM_ADDR_RIGHT_CH);
     aSetBuffer(cmd++, 0, 0, DMEM_ADDR_TEMP, temp * 2);
     aSaveBuffer(cmd++, VIRTUAL_TO_PHYSICAL2(aiBuf));
+#else
+    aInterleaveSave(cmd++, aiBuf, DMEM_ADDR_LEFT_CH, DMEM_ADDR_RIGHT_CH);
+#endif
     return cmd;
 }
 #else
@@ -506,6 +619,15 @@ u64 *synthesis_do_one_audio_update(s16 *aiBuf, s32 bufLen, u64 *cmd, u32 updateI
     UNUSED s32 pad2[1];
     s16 temp;
 
+#ifndef TARGET_N64
+    if (gSynthesisReverb.useReverb != 0 && gReverbMode == REVERB_MODE_FDN) {
+        // The wet buses only collect the sends of the notes, see synthesis_reverb_fdn
+        aClearBuffer(cmd++, DMEM_ADDR_LEFT_CH, DEFAULT_LEN_2CH);
+        aClearBuffer(cmd++, DMEM_ADDR_WET_LEFT_CH, DEFAULT_LEN_2CH);
+        return synthesis_process_notes(aiBuf, bufLen, cmd);
+    }
+#endif
+
     v1 = &gSynthesisReverb.items[gSynthesisReverb.curFrame][updateIndex];
 
     if (gSynthesisReverb.useReverb == 0) {
@@ -576,11 +698,16 @@ u64 *synthesis_do_one_audio_update(s16 *aiBuf, s32 bufLen, u64 *cmd, u32 updateI
 // Processes just one note, not all
 u64 *synthesis_process_note(struct Note *note, struct NoteSubEu *noteSubEu, struct NoteSynthesisState *synthesisState, UNUSED s16 *aiBuf, s32 bufLen, u64 *cmd) {
     UNUSED s32 pad0[3];
-#else
+#elif defined(TARGET_N64)
 u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
     s32 noteIndex;                           // sp174
     struct Note *note;                       // s7
     UNUSED u8 pad0[0x08];
+#else
+// Renders notes firstNote to lastNote - 1 into the mix buses, see synthesis_process_notes
+static u64 *synthesis_process_note_range(s32 firstNote, s32 lastNote, s32 bufLen, u64 *cmd) {
+    s32 noteIndex;
+    struct Note *note;
 #endif
     struct AudioBankSample *audioBookSample; // sp164, sp138
     struct AdpcmLoop *loopInfo;              // sp160, sp134
@@ -643,9 +770,9 @@ u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
 
     u32 samplesLenFixedPoint;    // v1_1
     s32 nSamplesInThisIteration; // v1_2
-    u32 a3;
+    UNUSED u32 a3; // only used for the DMEM copy on N64
 #ifndef VERSION_EU
-    s32 t9;
+    UNUSED s32 t9; // only used for the interleave on N64
 #endif
     u8 *v0_2;
     s32 nParts;                 // spE8, spBC
@@ -661,10 +788,17 @@ u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
 #endif
     s32 resampledTempLen;                    // spD8, spAC
     u16 noteSamplesDmemAddrBeforeResampling; // spD6, spAA
+#ifndef TARGET_N64
+    struct ADPCMSampleInfo sampleInfo;
+#endif
 
 
 #ifndef VERSION_EU
+#ifdef TARGET_N64
     for (noteIndex = 0; noteIndex < gMaxSimultaneousNotes; noteIndex++) {
+#else
+    for (noteIndex = firstNote; noteIndex < lastNote; noteIndex++) {
+#endif
         note = &gNotes[noteIndex];
 #ifdef VERSION_US
         //! This function requires note->enabled to be volatile, but it breaks other functions like note_enable.
@@ -759,6 +893,13 @@ u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
                 loopInfo = audioBookSample->loop;
                 endPos = loopInfo->end;
                 sampleAddr = audioBookSample->sampleAddr;
+#ifndef TARGET_N64
+                sampleInfo.key = audioBookSample;
+                sampleInfo.data = sampleAddr;
+                sampleInfo.num_frames = (endPos + 15) / 16;
+                sampleInfo.loop_frame = loopInfo->count != 0 ? (s32) loopInfo->start / 16 + 1 : -1;
+                sampleInfo.loop_state = loopInfo->state;
+#endif
                 resampledTempLen = 0;
                 for (curPart = 0; curPart < nParts; curPart++) {
                     nAdpcmSamplesProcessed = 0; // s8
@@ -858,11 +999,17 @@ u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
                                 t0 * 9, flags, &note->sampleDmaIndex);
 #endif
                             a3 = (u32)((uintptr_t) v0_2 & 0xf);
+#ifdef TARGET_N64
                             aSetBuffer(cmd++, 0, DMEM_ADDR_COMPRESSED_ADPCM_DATA, 0, t0 * 9 + a3);
                             aLoadBuffer(cmd++, VIRTUAL_TO_PHYSICAL2(v0_2 - a3));
+#endif
                         } else {
                             s0 = 0;
                             a3 = 0;
+#ifndef TARGET_N64
+                            v0_2 = NULL;
+                            temp = 0;
+#endif
                         }
 
 #ifdef VERSION_EU
@@ -882,28 +1029,50 @@ u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
                         nSamplesInThisIteration = s0 + s6 - s3;
 #ifdef VERSION_EU
                         if (nAdpcmSamplesProcessed == 0) {
+#ifdef TARGET_N64
                             aSetBuffer(cmd++, 0, DMEM_ADDR_COMPRESSED_ADPCM_DATA + a3,
                                        DMEM_ADDR_UNCOMPRESSED_NOTE, s0 * 2);
                             aADPCMdec(cmd++, flags,
                                       VIRTUAL_TO_PHYSICAL2(synthesisState->synthesisBuffers->adpcmdecState));
+#else
+                            aSetBuffer(cmd++, 0, 0, DMEM_ADDR_UNCOMPRESSED_NOTE, s0 * 2);
+                            aADPCMdecSample(cmd++, flags, synthesisState->synthesisBuffers->adpcmdecState, v0_2, &sampleInfo, temp);
+#endif
                             sp130 = s2 * 2;
                         } else {
                             s5Aligned = ALIGN(s5, 5);
+#ifdef TARGET_N64
                             aSetBuffer(cmd++, 0, DMEM_ADDR_COMPRESSED_ADPCM_DATA + a3,
                                        DMEM_ADDR_UNCOMPRESSED_NOTE + s5Aligned, s0 * 2);
                             aADPCMdec(cmd++, flags,
                                       VIRTUAL_TO_PHYSICAL2(synthesisState->synthesisBuffers->adpcmdecState));
+#else
+                            aSetBuffer(cmd++, 0, 0, DMEM_ADDR_UNCOMPRESSED_NOTE + s5Aligned, s0 * 2);
+                            aADPCMdecSample(cmd++, flags, synthesisState->synthesisBuffers->adpcmdecState, v0_2, &sampleInfo, temp);
+#endif
                             aDMEMMove(cmd++, DMEM_ADDR_UNCOMPRESSED_NOTE + s5Aligned + (s2 * 2),
                                       DMEM_ADDR_UNCOMPRESSED_NOTE + s5, (nSamplesInThisIteration) * 2);
                         }
 #else
                         if (nAdpcmSamplesProcessed == 0) {
+#ifdef TARGET_N64
                             aSetBuffer(cmd++, 0, DMEM_ADDR_COMPRESSED_ADPCM_DATA + a3, DMEM_ADDR_UNCOMPRESSED_NOTE, s0 * 2);
                             aADPCMdec(cmd++, flags, VIRTUAL_TO_PHYSICAL2(note->synthesisBuffers->adpcmdecState));
+#else
+                            // Decode straight from the sample data instead of a DMEM copy of it,
+                            // or copy the PCM when the mixer has the sample decoded already
+                            aSetBuffer(cmd++, 0, 0, DMEM_ADDR_UNCOMPRESSED_NOTE, s0 * 2);
+                            aADPCMdecSample(cmd++, flags, note->synthesisBuffers->adpcmdecState, v0_2, &sampleInfo, temp);
+#endif
                             sp130 = s2 * 2;
                         } else {
+#ifdef TARGET_N64
                             aSetBuffer(cmd++, 0, DMEM_ADDR_COMPRESSED_ADPCM_DATA + a3, DMEM_ADDR_UNCOMPRESSED_NOTE + ALIGN(s5, 5), s0 * 2);
                             aADPCMdec(cmd++, flags, VIRTUAL_TO_PHYSICAL2(note->synthesisBuffers->adpcmdecState));
+#else
+                            aSetBuffer(cmd++, 0, 0, DMEM_ADDR_UNCOMPRESSED_NOTE + ALIGN(s5, 5), s0 * 2);
+                            aADPCMdecSample(cmd++, flags, note->synthesisBuffers->adpcmdecState, v0_2, &sampleInfo, temp);
+#endif
                             aDMEMMove(cmd++, DMEM_ADDR_UNCOMPRESSED_NOTE + ALIGN(s5, 5) + (s2 * 2), DMEM_ADDR_UNCOMPRESSED_NOTE + s5, (nSamplesInThisIteration) * 2);
                         }
 #endif
@@ -1070,6 +1239,7 @@ u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
 #ifndef VERSION_EU
     }
 
+#ifdef TARGET_N64
     t9 = bufLen * 2;
     aSetBuffer(cmd++, 0, 0, DMEM_ADDR_TEMP, t9);
     aInterleave(cmd++, DMEM_ADDR_LEFT_CH, DMEM_ADDR_RIGHT_CH);
@@ -1077,9 +1247,153 @@ u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
     aSetBuffer(cmd++, 0, 0, DMEM_ADDR_TEMP, t9);
     aSaveBuffer(cmd++, VIRTUAL_TO_PHYSICAL2(aiBuf));
 #endif
+#endif
+
+    return cmd;
+}
+
+#ifdef PARALLEL_NOTE_SYNTHESIS
+struct NoteSynthesisJob {
+    u64 *cmd;
+    s32 bufLen;
+#ifdef VERSION_EU
+    const u8 *noteIndices;
+    s32 checkBankLoad;
+    u32 updateIndex;
+#endif
+    s32 bounds[AUDIO_MAX_WORKERS + 1]; // thread n renders from bounds[n] up to bounds[n + 1]
+};
+
+static struct MixerBusLog sNoteBusLogs[AUDIO_MAX_WORKERS];
+
+#ifdef VERSION_EU
+static u64 *synthesis_process_note_list_range(const u8 *noteIndices, s32 first, s32 last, s32 checkBankLoad,
+                                              u32 updateIndex, s32 bufLen, u64 *cmd) {
+    struct NoteSubEu *noteSubsEu = &gNoteSubsEu[updateIndex * gMaxSimultaneousNotes];
+    s32 i;
+
+    for (i = first; i < last; i++) {
+        struct NoteSubEu *noteSubEu = &noteSubsEu[noteIndices[i]];
+        if (!checkBankLoad || IS_BANK_LOAD_COMPLETE(noteSubEu->bankId) == TRUE) {
+            cmd = synthesis_process_note(&gNotes[noteIndices[i]], noteSubEu,
+                                         &gNotes[noteIndices[i]].synthesisState, NULL, bufLen, cmd);
+        } else {
+            gAudioErrorFlags = (noteSubEu->bankId + (i << 8)) + 0x10000000;
+        }
+    }
+    return cmd;
+}
+#endif
+
+static void synthesis_note_worker(u32 index, void *arg) {
+    struct NoteSynthesisJob *job = arg;
+    s32 first = job->bounds[index];
+    s32 last = job->bounds[index + 1];
+
+    if (index != 0) {
+        mixer_record_bus(&sNoteBusLogs[index], DMEM_ADDR_LEFT_CH, DMEM_ADDR_WET_RIGHT_CH + DEFAULT_LEN_1CH);
+    }
+#ifdef VERSION_EU
+    synthesis_process_note_list_range(job->noteIndices, first, last, job->checkBankLoad, job->updateIndex,
+                                      job->bufLen, job->cmd);
+#else
+    synthesis_process_note_range(first, last, job->bufLen, job->cmd);
+#endif
+    if (index != 0) {
+        mixer_record_bus(NULL, 0, 0);
+    }
+}
+
+// Renders the notes of a job split across the audio workers. The calling thread mixes the first
+// share straight into the buses while the workers record how they would mix theirs; replaying
+// those records in thread order afterwards does the saturating adds into the buses in the same
+// order as rendering every note on one thread, so the output is bit-exact either way.
+static u64 *synthesis_run_note_job(struct NoteSynthesisJob *job, u64 *cmd) {
+    u32 numThreads = audio_workers_count();
+    u32 i;
+
+    job->cmd = cmd;
+    audio_workers_run(synthesis_note_worker, job);
+    for (i = 1; i < numThreads; i++) {
+        mixer_replay_bus(&sNoteBusLogs[i]);
+    }
+    return cmd;
+}
+
+#ifdef VERSION_EU
+u64 *synthesis_process_note_list(const u8 *noteIndices, s32 first, s32 last, s32 checkBankLoad, u32 updateIndex,
+                                 s32 bufLen, u64 *cmd) {
+    struct NoteSynthesisJob job;
+    s32 numThreads = audio_workers_count();
+    s32 i;
+
+    if ((last - first) / MIN_NOTES_PER_WORKER < numThreads) {
+        numThreads = (last - first) / MIN_NOTES_PER_WORKER;
+    }
+    if (numThreads <= 1) {
+        return synthesis_process_note_list_range(noteIndices, first, last, checkBankLoad, updateIndex, bufLen, cmd);
+    }
+
+    job.bufLen = bufLen;
+    job.noteIndices = noteIndices;
+    job.checkBankLoad = checkBankLoad;
+    job.updateIndex = updateIndex;
+    for (i = 0; i <= AUDIO_MAX_WORKERS; i++) {
+        job.bounds[i] = i < numThreads ? first + (last - first) * i / numThreads : last;
+    }
+    return synthesis_run_note_job(&job, cmd);
+}
+#endif
+#endif
 
+#if !defined(VERSION_EU) && !defined(TARGET_N64)
+u64 *synthesis_process_notes(s16 *aiBuf, s32 bufLen, u64 *cmd) {
+#ifdef PARALLEL_NOTE_SYNTHESIS
+    struct NoteSynthesisJob job;
+    s32 numThreads = audio_workers_count();
+    s32 numNotes = 0;
+    s32 i;
+    s32 k;
+    s32 n;
+
+    for (i = 0; i < gMaxSimultaneousNotes; i++) {
+        numNotes += gNotes[i].enabled;
+    }
+    if (numNotes / MIN_NOTES_PER_WORKER < numThreads) {
+        numThreads = numNotes / MIN_NOTES_PER_WORKER;
+    }
+
+    if (numThreads > 1) {
+        // Give each thread a run of neighbouring notes with about as many of them enabled
+        job.bufLen = bufLen;
+        job.bounds[0] = 0;
+        for (i = 0, n = 0, k = 1; i < gMaxSimultaneousNotes && k < numThreads; i++) {
+            if (gNotes[i].enabled) {
+                if (n == numNotes * k / numThreads) {
+                    job.bounds[k++] = i;
+                }
+                n++;
+            }
+        }
+        for (; k <= AUDIO_MAX_WORKERS; k++) {
+            job.bounds[k] = gMaxSimultaneousNotes;
+        }
+        cmd = synthesis_run_note_job(&job, cmd);
+    } else
+#endif
+    {
+        cmd = synthesis_process_note_range(0, gMaxSimultaneousNotes, bufLen, cmd);
+    }
+    if (gSynthesisReverb.useReverb != 0 && gReverbMode == REVERB_MODE_FDN) {
+        cmd = synthesis_reverb_fdn(cmd, 0, bufLen);
+    }
+
+    // Interleave straight into the output buffer instead of staging it in DMEM
+    aSetBuffer(cmd++, 0, 0, DMEM_ADDR_TEMP, bufLen * 2);
+    aInterleaveSave(cmd++, aiBuf, DMEM_ADDR_LEFT_CH, DMEM_ADDR_RIGHT_CH);
     return cmd;
 }
+#endif
 
 #ifdef VERSION_EU
 u64 *load_wave_samples(u64 *cmd, struct NoteSubEu *noteSubEu, struct NoteSynthesisState *synthesisState, s32 nSamplesToLoad) {
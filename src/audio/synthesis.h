@@ -6,7 +6,10 @@
 #define DEFAULT_LEN_1CH 0x140
 #define DEFAULT_LEN_2CH 0x280
 
-#ifdef VERSION_EU
+#ifndef TARGET_N64
+// Output rates up to 48 kHz take more updates per frame
+#define MAX_UPDATES_PER_FRAME 8
+#elif defined(VERSION_EU)
 #define MAX_UPDATES_PER_FRAME 5
 #else
 #define MAX_UPDATES_PER_FRAME 4
@@ -73,4 +76,8 @@ void note_enable(struct Note *note);
 void note_disable(struct Note *note);
 #endif
 
+#ifndef TARGET_N64
+void synthesis_reset_reverb_fdns(void);
+#endif
+
 #endif // AUDIO_SYNTHESIS_H
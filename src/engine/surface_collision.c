@@ -8,6 +8,251 @@
 #include "surface_collision.h"
 #include "surface_load.h"
 
+#ifndef TARGET_N64
+#include <stdlib.h>
+#endif
+
+#ifdef PACKED_SURFACES
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#define PACKED_SURFACES_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PACKED_SURFACES_NEON
+#endif
+
+/**
+ * The static partition is copied into blocks of four surfaces per cell list, in list order,
+ * after a level area is loaded. Queries test a whole block at once for the cheap rejections
+ * and pass only the surviving surfaces, still in list order, to the usual *_from_list
+ * functions, so the results are exactly the same as walking the lists.
+ */
+#define PACK_WIDTH 4
+
+/**
+ * Edge functions a * x + b * z + c of four floors or ceilings. Expanding the edge tests of
+ * find_floor_from_list and find_ceil_from_list this way gives the same wrapping s32 values.
+ * Unused lanes fail every test.
+ */
+struct PackedTris {
+    s32 a[3][PACK_WIDTH];
+    s32 b[3][PACK_WIDTH];
+    s32 c[3][PACK_WIDTH];
+    struct Surface *surfaces[PACK_WIDTH];
+};
+
+/**
+ * Height range and plane of four walls. Unused lanes have an empty height range and
+ * no surface.
+ */
+struct PackedWalls {
+    f32 lowerY[PACK_WIDTH];
+    f32 upperY[PACK_WIDTH];
+    f32 nx[PACK_WIDTH];
+    f32 ny[PACK_WIDTH];
+    f32 nz[PACK_WIDTH];
+    f32 originOffset[PACK_WIDTH];
+    struct Surface *surfaces[PACK_WIDTH];
+};
+
+struct PackedCell {
+    u32 start;
+    u32 numBlocks;
+};
+
+static struct PackedCell sPackedCells[NUM_CELLS][NUM_CELLS][3];
+static struct PackedTris *sPackedTris;
+static struct PackedWalls *sPackedWalls;
+static u32 sPackedTrisCapacity;
+static u32 sPackedWallsCapacity;
+
+// Wall candidates of one cell, chained together for find_wall_collisions_from_list
+static struct SurfaceNode *sWallCandidates;
+static u32 sWallCandidatesCapacity;
+
+// The walls' plane distance is computed without FMA contraction, so only reject clear misses
+#define WALL_OFFSET_MARGIN 1.0f
+
+#ifdef PACKED_SURFACES_SSE2
+static inline __m128i packed_mullo_epi32(__m128i a, __m128i b) {
+#ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#else
+    // The low halves of the unsigned products are the wrapping signed ones
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static inline __m128i packed_edge(const struct PackedTris *tris, s32 edge, __m128i x, __m128i z) {
+    __m128i a = _mm_loadu_si128((const __m128i *) tris->a[edge]);
+    __m128i b = _mm_loadu_si128((const __m128i *) tris->b[edge]);
+    __m128i c = _mm_loadu_si128((const __m128i *) tris->c[edge]);
+
+    return _mm_add_epi32(_mm_add_epi32(packed_mullo_epi32(a, x), packed_mullo_epi32(b, z)), c);
+}
+#elif defined(PACKED_SURFACES_NEON)
+static inline s32 packed_mask(uint32x4_t m) {
+    static const u32 bits[PACK_WIDTH] = { 1, 2, 4, 8 };
+    uint32x4_t v = vandq_u32(m, vld1q_u32(bits));
+    uint32x2_t sum = vadd_u32(vget_low_u32(v), vget_high_u32(v));
+
+    return vget_lane_u32(vpadd_u32(sum, sum), 0);
+}
+
+static inline int32x4_t packed_edge(const struct PackedTris *tris, s32 edge, int32x4_t x, int32x4_t z) {
+    int32x4_t e = vld1q_s32(tris->c[edge]);
+
+    e = vmlaq_s32(e, vld1q_s32(tris->a[edge]), x);
+    return vmlaq_s32(e, vld1q_s32(tris->b[edge]), z);
+}
+#else
+static inline s32 packed_edge(const struct PackedTris *tris, s32 edge, s32 lane, s32 x, s32 z) {
+    return (s32)((u32) tris->a[edge][lane] * (u32) x + (u32) tris->b[edge][lane] * (u32) z
+                 + (u32) tris->c[edge][lane]);
+}
+#endif
+
+/**
+ * Return a bit for each floor of the block that (x, z) is not outside of.
+ */
+static s32 packed_floor_candidates(const struct PackedTris *tris, s32 x, s32 z) {
+#ifdef PACKED_SURFACES_SSE2
+    __m128i vx = _mm_set1_epi32(x);
+    __m128i vz = _mm_set1_epi32(z);
+    // A floor is missed if any edge function is negative
+    __m128i outside = _mm_or_si128(_mm_or_si128(packed_edge(tris, 0, vx, vz), packed_edge(tris, 1, vx, vz)),
+                                   packed_edge(tris, 2, vx, vz));
+
+    return ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+#elif defined(PACKED_SURFACES_NEON)
+    int32x4_t vx = vdupq_n_s32(x);
+    int32x4_t vz = vdupq_n_s32(z);
+    int32x4_t zero = vdupq_n_s32(0);
+    uint32x4_t outside = vorrq_u32(vorrq_u32(vcltq_s32(packed_edge(tris, 0, vx, vz), zero),
+                                             vcltq_s32(packed_edge(tris, 1, vx, vz), zero)),
+                                   vcltq_s32(packed_edge(tris, 2, vx, vz), zero));
+
+    return ~packed_mask(outside) & 0xF;
+#else
+    s32 mask = 0;
+    s32 i;
+
+    for (i = 0; i < PACK_WIDTH; i++) {
+        if (packed_edge(tris, 0, i, x, z) >= 0 && packed_edge(tris, 1, i, x, z) >= 0
+            && packed_edge(tris, 2, i, x, z) >= 0) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+/**
+ * Return a bit for each ceiling of the block that (x, z) is not outside of.
+ */
+static s32 packed_ceil_candidates(const struct PackedTris *tris, s32 x, s32 z) {
+#ifdef PACKED_SURFACES_SSE2
+    __m128i vx = _mm_set1_epi32(x);
+    __m128i vz = _mm_set1_epi32(z);
+    __m128i zero = _mm_setzero_si128();
+    // A ceiling is missed if any edge function is positive
+    __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(packed_edge(tris, 0, vx, vz), zero),
+                                                _mm_cmpgt_epi32(packed_edge(tris, 1, vx, vz), zero)),
+                                   _mm_cmpgt_epi32(packed_edge(tris, 2, vx, vz), zero));
+
+    return ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+#elif defined(PACKED_SURFACES_NEON)
+    int32x4_t vx = vdupq_n_s32(x);
+    int32x4_t vz = vdupq_n_s32(z);
+    int32x4_t zero = vdupq_n_s32(0);
+    uint32x4_t outside = vorrq_u32(vorrq_u32(vcgtq_s32(packed_edge(tris, 0, vx, vz), zero),
+                                             vcgtq_s32(packed_edge(tris, 1, vx, vz), zero)),
+                                   vcgtq_s32(packed_edge(tris, 2, vx, vz), zero));
+
+    return ~packed_mask(outside) & 0xF;
+#else
+    s32 mask = 0;
+    s32 i;
+
+    for (i = 0; i < PACK_WIDTH; i++) {
+        if (packed_edge(tris, 0, i, x, z) <= 0 && packed_edge(tris, 1, i, x, z) <= 0
+            && packed_edge(tris, 2, i, x, z) <= 0) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+/**
+ * Return a bit for each wall of the block whose height range contains y and whose plane
+ * may be within radius of (x, y, z).
+ */
+static s32 packed_wall_candidates(const struct PackedWalls *walls, f32 x, f32 y, f32 z, f32 radius) {
+    f32 limit = radius + WALL_OFFSET_MARGIN;
+#ifdef PACKED_SURFACES_SSE2
+    __m128 vy = _mm_set1_ps(y);
+    __m128 offset = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(walls->nx), _mm_set1_ps(x)),
+                                          _mm_mul_ps(_mm_loadu_ps(walls->ny), vy)),
+                               _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(walls->nz), _mm_set1_ps(z)),
+                                          _mm_loadu_ps(walls->originOffset)));
+    __m128 absOffset = _mm_andnot_ps(_mm_set1_ps(-0.0f), offset);
+    __m128 miss = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(vy, _mm_loadu_ps(walls->lowerY)),
+                                      _mm_cmpgt_ps(vy, _mm_loadu_ps(walls->upperY))),
+                            _mm_cmpgt_ps(absOffset, _mm_set1_ps(limit)));
+
+    return ~_mm_movemask_ps(miss) & 0xF;
+#elif defined(PACKED_SURFACES_NEON)
+    float32x4_t vy = vdupq_n_f32(y);
+    float32x4_t offset = vaddq_f32(vaddq_f32(vmulq_f32(vld1q_f32(walls->nx), vdupq_n_f32(x)),
+                                             vmulq_f32(vld1q_f32(walls->ny), vy)),
+                                   vaddq_f32(vmulq_f32(vld1q_f32(walls->nz), vdupq_n_f32(z)),
+                                             vld1q_f32(walls->originOffset)));
+    uint32x4_t miss = vorrq_u32(vorrq_u32(vcltq_f32(vy, vld1q_f32(walls->lowerY)),
+                                          vcgtq_f32(vy, vld1q_f32(walls->upperY))),
+                                vcgtq_f32(vabsq_f32(offset), vdupq_n_f32(limit)));
+
+    return ~packed_mask(miss) & 0xF;
+#else
+    s32 mask = 0;
+    s32 i;
+
+    for (i = 0; i < PACK_WIDTH; i++) {
+        f32 offset = walls->nx[i] * x + walls->ny[i] * y + walls->nz[i] * z + walls->originOffset[i];
+
+        if (!(y < walls->lowerY[i] || y > walls->upperY[i] || offset < -limit || offset > limit)) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+/**
+ * Copy the surfaces picked by mask into consecutive nodes, each linked to the next one.
+ * The caller terminates the list. Returns the number of nodes used.
+ */
+static s32 collect_packed_candidates(struct SurfaceNode *nodes, struct Surface **surfaces, s32 mask) {
+    s32 count = 0;
+    s32 i;
+
+    for (i = 0; i < PACK_WIDTH; i++) {
+        if ((mask & (1 << i)) && surfaces[i] != NULL) {
+            nodes[count].surface = surfaces[i];
+            nodes[count].next = &nodes[count + 1];
+            count++;
+        }
+    }
+    return count;
+}
+#endif
+
 /**************************************************
  *                      WALLS                     *
  **************************************************/
@@ -153,6 +398,41 @@ static s32 find_wall_collisions_from_list(struct SurfaceNode *surfaceNode,
     return numCols;
 }
 
+#ifdef PACKED_SURFACES
+/**
+ * find_wall_collisions_from_list for the packed static walls of a cell.
+ */
+static s32 find_wall_collisions_from_pack(s16 cellX, s16 cellZ, struct WallCollisionData *data) {
+    struct PackedCell *cell = &sPackedCells[cellZ][cellX][SPATIAL_PARTITION_WALLS];
+    struct PackedWalls *walls = &sPackedWalls[cell->start];
+    s32 numCandidates = 0;
+    f32 radius = data->radius;
+    f32 x = data->x;
+    f32 y = data->y + data->offsetY;
+    f32 z = data->z;
+    u32 i;
+
+    if (radius > 200.0f) {
+        radius = 200.0f;
+    }
+
+    // Every wall is pushed from the same position, so collect all candidates and make one pass
+    for (i = 0; i < cell->numBlocks; i++, walls++) {
+        s32 mask = packed_wall_candidates(walls, x, y, z, radius);
+
+        if (mask != 0) {
+            numCandidates += collect_packed_candidates(&sWallCandidates[numCandidates], walls->surfaces, mask);
+        }
+    }
+    if (numCandidates == 0) {
+        return 0;
+    }
+
+    sWallCandidates[numCandidates - 1].next = NULL;
+    return find_wall_collisions_from_list(sWallCandidates, data);
+}
+#endif
+
 /**
  * Formats the position and wall search for find_wall_collisions.
  */
@@ -197,18 +477,22 @@ s32 find_wall_collisions(struct WallCollisionData *colData) {
         return numCollisions;
     }
 
-    // World (level) consists of a 16x16 grid. Find where the collision is on
+    // World (level) consists of a NUM_CELLS x NUM_CELLS grid. Find where the collision is on
     // the grid (round toward -inf)
-    cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0x0F;
-    cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0x0F;
+    cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
     // Check for surfaces belonging to objects.
     node = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
     numCollisions += find_wall_collisions_from_list(node, colData);
 
     // Check for surfaces that are a part of level geometry.
+#ifdef PACKED_SURFACES
+    numCollisions += find_wall_collisions_from_pack(cellX, cellZ, colData);
+#else
     node = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_WALLS].next;
     numCollisions += find_wall_collisions_from_list(node, colData);
+#endif
 
     // Increment the debug tracker.
     gNumCalls.wall += 1;
@@ -300,6 +584,32 @@ static struct Surface *find_ceil_from_list(struct SurfaceNode *surfaceNode, s32
     return ceil;
 }
 
+#ifdef PACKED_SURFACES
+/**
+ * find_ceil_from_list for the packed static ceilings of a cell.
+ */
+static struct Surface *find_ceil_from_pack(s16 cellX, s16 cellZ, s32 x, s32 y, s32 z, f32 *pheight) {
+    struct PackedCell *cell = &sPackedCells[cellZ][cellX][SPATIAL_PARTITION_CEILS];
+    struct PackedTris *tris = &sPackedTris[cell->start];
+    struct SurfaceNode nodes[PACK_WIDTH];
+    struct Surface *ceil;
+    s32 count;
+    u32 i;
+
+    for (i = 0; i < cell->numBlocks; i++, tris++) {
+        s32 mask = packed_ceil_candidates(tris, x, z);
+
+        if (mask != 0 && (count = collect_packed_candidates(nodes, tris->surfaces, mask)) != 0) {
+            nodes[count - 1].next = NULL;
+            if ((ceil = find_ceil_from_list(nodes, x, y, z, pheight)) != NULL) {
+                return ceil;
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
 /**
  * Find the lowest ceiling above a given position and return the height.
  */
@@ -327,16 +637,20 @@ f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil) {
     }
 
     // Each level is split into cells to limit load, find the appropriate cell.
-    cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0xF;
-    cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0xF;
+    cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
     // Check for surfaces belonging to objects.
     surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
     dynamicCeil = find_ceil_from_list(surfaceList, x, y, z, &dynamicHeight);
 
     // Check for surfaces that are a part of level geometry.
+#ifdef PACKED_SURFACES
+    ceil = find_ceil_from_pack(cellX, cellZ, x, y, z, &height);
+#else
     surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_CEILS].next;
     ceil = find_ceil_from_list(surfaceList, x, y, z, &height);
+#endif
 
     if (dynamicHeight < height) {
         ceil = dynamicCeil;
@@ -468,6 +782,32 @@ static struct Surface *find_floor_from_list(struct SurfaceNode *surfaceNode, s32
     return floor;
 }
 
+#ifdef PACKED_SURFACES
+/**
+ * find_floor_from_list for the packed static floors of a cell.
+ */
+static struct Surface *find_floor_from_pack(s16 cellX, s16 cellZ, s32 x, s32 y, s32 z, f32 *pheight) {
+    struct PackedCell *cell = &sPackedCells[cellZ][cellX][SPATIAL_PARTITION_FLOORS];
+    struct PackedTris *tris = &sPackedTris[cell->start];
+    struct SurfaceNode nodes[PACK_WIDTH];
+    struct Surface *floor;
+    s32 count;
+    u32 i;
+
+    for (i = 0; i < cell->numBlocks; i++, tris++) {
+        s32 mask = packed_floor_candidates(tris, x, z);
+
+        if (mask != 0 && (count = collect_packed_candidates(nodes, tris->surfaces, mask)) != 0) {
+            nodes[count - 1].next = NULL;
+            if ((floor = find_floor_from_list(nodes, x, y, z, pheight)) != NULL) {
+                return floor;
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
 /**
  * Find the height of the highest floor below a point.
  */
@@ -494,8 +834,8 @@ f32 unused_find_dynamic_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfl
     s16 z = (s16) zPos;
 
     // Each level is split into cells to limit load, find the appropriate cell.
-    s16 cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0x0F;
-    s16 cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0x0F;
+    s16 cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    s16 cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
     surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
     floor = find_floor_from_list(surfaceList, x, y, z, &floorHeight);
@@ -505,6 +845,178 @@ f32 unused_find_dynamic_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfl
     return floorHeight;
 }
 
+#ifdef FLOOR_CACHE
+/**
+ * Results of find_floor since the partitions last changed, by position. Objects and their
+ * shadows often ask for the floor at the same spot several times a frame, and find_floors
+ * fills this ahead of time in cell order.
+ */
+struct FloorCacheEntry {
+    u32 version;
+    s16 x, y, z;
+    s8 camera;
+    s8 missedStatic;
+    f32 height;
+    struct Surface *floor;
+};
+
+static struct FloorCacheEntry sFloorCache[FLOOR_CACHE_SIZE];
+static u32 sFloorCacheVersion = 1;
+
+/**
+ * Forget every cached floor. Called whenever a surface is added or the partitions are cleared.
+ */
+void clear_floor_cache(void) {
+    sFloorCacheVersion++;
+}
+
+/**
+ * find_floor without the debug counters, for a position within the level boundary.
+ * Sets *missedStatic if there is no static floor.
+ */
+static f32 find_floor_in_cell(s16 x, s16 y, s16 z, s32 includeIntangible, struct Surface **pfloor,
+                              s8 *missedStatic) {
+    s16 cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    s16 cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    struct Surface *floor, *dynamicFloor;
+    struct SurfaceNode *surfaceList;
+    f32 height = -11000.0f;
+    f32 dynamicHeight = -11000.0f;
+
+    surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
+    dynamicFloor = find_floor_from_list(surfaceList, x, y, z, &dynamicHeight);
+
+    surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
+#ifdef PACKED_SURFACES
+    floor = find_floor_from_pack(cellX, cellZ, x, y, z, &height);
+#else
+    floor = find_floor_from_list(surfaceList, x, y, z, &height);
+#endif
+
+    // See find_floor below for the BBH crash this keeps
+    if (!includeIntangible && floor != NULL && floor->type == SURFACE_INTANGIBLE) {
+        floor = find_floor_from_list(surfaceList, x, (s32)(height - 200.0f), z, &height);
+    }
+
+    *missedStatic = floor == NULL;
+
+    if (dynamicHeight > height) {
+        floor = dynamicFloor;
+        height = dynamicHeight;
+    }
+
+    *pfloor = floor;
+    return height;
+}
+
+/**
+ * Return the cache entry for a position within the level boundary, filling it if needed.
+ */
+static struct FloorCacheEntry *find_cached_floor(s16 x, s16 y, s16 z) {
+    s8 camera = gCheckingSurfaceCollisionsForCamera != 0;
+    u32 hash = (u16) x * 0x9E3779B1u ^ (u16) y * 0x85EBCA77u ^ (u16) z * 0xC2B2AE3Du;
+    struct FloorCacheEntry *entry = &sFloorCache[(hash >> 24) % FLOOR_CACHE_SIZE];
+
+    if (entry->version != sFloorCacheVersion || entry->x != x || entry->y != y || entry->z != z
+        || entry->camera != camera) {
+        entry->height = find_floor_in_cell(x, y, z, FALSE, &entry->floor, &entry->missedStatic);
+        entry->version = sFloorCacheVersion;
+        entry->x = x;
+        entry->y = y;
+        entry->z = z;
+        entry->camera = camera;
+    }
+    return entry;
+}
+
+/**
+ * Find the highest floor under a given position and return the height.
+ */
+f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
+    struct FloorCacheEntry *entry;
+    f32 height;
+    s8 missedStatic;
+
+    //! (Parallel Universes) Because position is casted to an s16, reaching higher
+    // float locations  can return floors despite them not existing there.
+    //(Dynamic floors will unload due to the range.)
+    s16 x = (s16) xPos;
+    s16 y = (s16) yPos;
+    s16 z = (s16) zPos;
+
+    *pfloor = NULL;
+
+    if (x <= -LEVEL_BOUNDARY_MAX || x >= LEVEL_BOUNDARY_MAX) {
+        return -11000.0f;
+    }
+    if (z <= -LEVEL_BOUNDARY_MAX || z >= LEVEL_BOUNDARY_MAX) {
+        return -11000.0f;
+    }
+
+    if (gFindFloorIncludeSurfaceIntangible) {
+        // To prevent accidentally leaving the floor tangible, stop checking for it.
+        gFindFloorIncludeSurfaceIntangible = FALSE;
+        height = find_floor_in_cell(x, y, z, TRUE, pfloor, &missedStatic);
+    } else {
+        entry = find_cached_floor(x, y, z);
+        *pfloor = entry->floor;
+        height = entry->height;
+        missedStatic = entry->missedStatic;
+    }
+
+    // If a floor was missed, increment the debug counter.
+    if (missedStatic) {
+        gNumFindFloorMisses += 1;
+    }
+
+    // Increment the debug tracker.
+    gNumCalls.floor += 1;
+
+    return height;
+}
+
+static int compare_floor_query_cells(const void *a, const void *b) {
+    return (s32)(*(const u32 *) a >> 16) - (s32)(*(const u32 *) b >> 16);
+}
+
+/**
+ * Find the floors under many positions at once, in cell order so that each cell's surfaces
+ * are only brought into the cache once. Gives the same results as find_floor for each query,
+ * but leaves the debug counters alone and doesn't include SURFACE_INTANGIBLE floors.
+ */
+void find_floors(struct FloorQuery *queries, s32 count) {
+    static u32 order[MAX_FLOOR_QUERIES];
+    s32 numInBounds = 0;
+    s32 i;
+
+    for (; count > MAX_FLOOR_QUERIES; queries += MAX_FLOOR_QUERIES, count -= MAX_FLOOR_QUERIES) {
+        find_floors(queries, MAX_FLOOR_QUERIES);
+    }
+
+    for (i = 0; i < count; i++) {
+        s16 x = (s16) queries[i].x;
+        s16 z = (s16) queries[i].z;
+
+        queries[i].height = -11000.0f;
+        queries[i].floor = NULL;
+        if (x > -LEVEL_BOUNDARY_MAX && x < LEVEL_BOUNDARY_MAX && z > -LEVEL_BOUNDARY_MAX
+            && z < LEVEL_BOUNDARY_MAX) {
+            u32 cell = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) * NUM_CELLS + (x + LEVEL_BOUNDARY_MAX) / CELL_SIZE;
+            order[numInBounds++] = cell << 16 | i;
+        }
+    }
+
+    qsort(order, numInBounds, sizeof(order[0]), compare_floor_query_cells);
+
+    for (i = 0; i < numInBounds; i++) {
+        struct FloorQuery *query = &queries[order[i] & 0xFFFF];
+        struct FloorCacheEntry *entry = find_cached_floor((s16) query->x, (s16) query->y, (s16) query->z);
+
+        query->height = entry->height;
+        query->floor = entry->floor;
+    }
+}
+#else
 /**
  * Find the highest floor under a given position and return the height.
  */
@@ -534,8 +1046,8 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
     }
 
     // Each level is split into cells to limit load, find the appropriate cell.
-    cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0xF;
-    cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & 0xF;
+    cellX = ((x + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
+    cellZ = ((z + LEVEL_BOUNDARY_MAX) / CELL_SIZE) & NUM_CELLS_INDEX;
 
     // Check for surfaces belonging to objects.
     surfaceList = gDynamicSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
@@ -543,7 +1055,11 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
 
     // Check for surfaces that are a part of level geometry.
     surfaceList = gStaticSurfacePartition[cellZ][cellX][SPATIAL_PARTITION_FLOORS].next;
+#ifdef PACKED_SURFACES
+    floor = find_floor_from_pack(cellX, cellZ, x, y, z, &height);
+#else
     floor = find_floor_from_list(surfaceList, x, y, z, &height);
+#endif
 
     // To prevent the Merry-Go-Round room from loading when Mario passes above the hole that leads
     // there, SURFACE_INTANGIBLE is used. This prevent the wrong room from loading, but can also allow
@@ -579,6 +1095,38 @@ f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor) {
     return height;
 }
 
+#endif
+
+/**
+ * Return whether any cell within `radius` of (xPos, zPos) contains dynamic floors, i.e. whether
+ * find_floor queries in that area could return something other than level geometry.
+ */
+s32 dynamic_floors_in_range(f32 xPos, f32 zPos, f32 radius) {
+    s16 minCellX, maxCellX, minCellZ, maxCellZ;
+    s16 cellX, cellZ;
+    f32 lo = -LEVEL_BOUNDARY_MAX + 1;
+    f32 hi = LEVEL_BOUNDARY_MAX - 1;
+
+    if (radius < 0.0f) {
+        radius = -radius;
+    }
+
+    // find_floor returns early outside of the level boundary, so only clamp the covered range
+    minCellX = (((s16) MAX(xPos - radius, lo)) + LEVEL_BOUNDARY_MAX) / CELL_SIZE;
+    maxCellX = (((s16) MIN(xPos + radius, hi)) + LEVEL_BOUNDARY_MAX) / CELL_SIZE;
+    minCellZ = (((s16) MAX(zPos - radius, lo)) + LEVEL_BOUNDARY_MAX) / CELL_SIZE;
+    maxCellZ = (((s16) MIN(zPos + radius, hi)) + LEVEL_BOUNDARY_MAX) / CELL_SIZE;
+
+    for (cellZ = minCellZ; cellZ <= maxCellZ; cellZ++) {
+        for (cellX = minCellX; cellX <= maxCellX; cellX++) {
+            if (gDynamicSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_FLOORS].next != NULL) {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
 /**************************************************
  *               ENVIRONMENTAL BOXES              *
  **************************************************/
@@ -689,25 +1237,25 @@ void debug_surface_list_info(f32 xPos, f32 zPos) {
     s32 cellX = (xPos + LEVEL_BOUNDARY_MAX) / CELL_SIZE;
     s32 cellZ = (zPos + LEVEL_BOUNDARY_MAX) / CELL_SIZE;
 
-    list = gStaticSurfacePartition[cellZ & 0x0F][cellX & 0x0F][SPATIAL_PARTITION_FLOORS].next;
+    list = gStaticSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_FLOORS].next;
     numFloors += surface_list_length(list);
 
-    list = gDynamicSurfacePartition[cellZ & 0x0F][cellX & 0x0F][SPATIAL_PARTITION_FLOORS].next;
+    list = gDynamicSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_FLOORS].next;
     numFloors += surface_list_length(list);
 
-    list = gStaticSurfacePartition[cellZ & 0x0F][cellX & 0x0F][SPATIAL_PARTITION_WALLS].next;
+    list = gStaticSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_WALLS].next;
     numWalls += surface_list_length(list);
 
-    list = gDynamicSurfacePartition[cellZ & 0x0F][cellX & 0x0F][SPATIAL_PARTITION_WALLS].next;
+    list = gDynamicSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_WALLS].next;
     numWalls += surface_list_length(list);
 
-    list = gStaticSurfacePartition[cellZ & 0x0F][cellX & 0x0F][SPATIAL_PARTITION_CEILS].next;
+    list = gStaticSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_CEILS].next;
     numCeils += surface_list_length(list);
 
-    list = gDynamicSurfacePartition[cellZ & 0x0F][cellX & 0x0F][SPATIAL_PARTITION_CEILS].next;
+    list = gDynamicSurfacePartition[cellZ & NUM_CELLS_INDEX][cellX & NUM_CELLS_INDEX][SPATIAL_PARTITION_CEILS].next;
     numCeils += surface_list_length(list);
 
-    print_debug_top_down_mapinfo("area   %x", cellZ * 16 + cellX);
+    print_debug_top_down_mapinfo("area   %x", cellZ * NUM_CELLS + cellX);
 
     // Names represent ground, walls, and roofs as found in SMS.
     print_debug_top_down_mapinfo("dg %d", numFloors);
@@ -775,3 +1323,147 @@ s32 unused_resolve_floor_or_ceil_collisions(s32 checkCeil, f32 *px, f32 *py, f32
 
     return 0;
 }
+
+#ifdef PACKED_SURFACES
+/**************************************************
+ *                 PACKED SURFACES                *
+ **************************************************/
+
+/**
+ * Fill the edge functions of lane i for the edge from (x1, z1) to (x2, z2), so that
+ * a * x + b * z + c == (z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) in wrapping arithmetic.
+ */
+static void pack_edge(struct PackedTris *tris, s32 edge, s32 i, s32 x1, s32 z1, s32 x2, s32 z2) {
+    u32 dx = (u32) x2 - (u32) x1;
+    u32 dz = (u32) z2 - (u32) z1;
+
+    tris->a[edge][i] = (s32) dz;
+    tris->b[edge][i] = (s32) -dx;
+    tris->c[edge][i] = (s32)((u32) z1 * dx - (u32) x1 * dz);
+}
+
+static void pack_tris(struct PackedTris *tris, struct SurfaceNode *node, s32 listIndex) {
+    s32 i, edge;
+
+    for (i = 0; i < PACK_WIDTH; i++) {
+        struct Surface *surf = node != NULL ? node->surface : NULL;
+
+        tris->surfaces[i] = surf;
+        if (surf == NULL) {
+            // Negative for floors, positive for ceilings, outside either way
+            for (edge = 0; edge < 3; edge++) {
+                tris->a[edge][i] = 0;
+                tris->b[edge][i] = 0;
+                tris->c[edge][i] = listIndex == SPATIAL_PARTITION_FLOORS ? -1 : 1;
+            }
+            continue;
+        }
+
+        pack_edge(tris, 0, i, surf->vertex1[0], surf->vertex1[2], surf->vertex2[0], surf->vertex2[2]);
+        pack_edge(tris, 1, i, surf->vertex2[0], surf->vertex2[2], surf->vertex3[0], surf->vertex3[2]);
+        pack_edge(tris, 2, i, surf->vertex3[0], surf->vertex3[2], surf->vertex1[0], surf->vertex1[2]);
+        node = node->next;
+    }
+}
+
+static void pack_walls(struct PackedWalls *walls, struct SurfaceNode *node) {
+    s32 i;
+
+    for (i = 0; i < PACK_WIDTH; i++) {
+        struct Surface *surf = node != NULL ? node->surface : NULL;
+
+        walls->surfaces[i] = surf;
+        if (surf == NULL) {
+            walls->lowerY[i] = 1.0e30f;
+            walls->upperY[i] = -1.0e30f;
+            walls->nx[i] = walls->ny[i] = walls->nz[i] = walls->originOffset[i] = 0.0f;
+            continue;
+        }
+
+        walls->lowerY[i] = surf->lowerY;
+        walls->upperY[i] = surf->upperY;
+        walls->nx[i] = surf->normal.x;
+        walls->ny[i] = surf->normal.y;
+        walls->nz[i] = surf->normal.z;
+        walls->originOffset[i] = surf->originOffset;
+        node = node->next;
+    }
+}
+
+static u32 surface_node_list_length(struct SurfaceNode *node) {
+    u32 count = 0;
+
+    while (node != NULL) {
+        count++;
+        node = node->next;
+    }
+    return count;
+}
+
+/**
+ * Rebuild the packed copy of gStaticSurfacePartition. Called once the static surfaces of
+ * an area are loaded.
+ */
+void pack_static_surface_partition(void) {
+    u32 numTris = 0;
+    u32 numWalls = 0;
+    u32 maxWalls = 0;
+    s32 cellX, cellZ, listIndex;
+
+    // Count the blocks first so each array is allocated once
+    for (cellZ = 0; cellZ < NUM_CELLS; cellZ++) {
+        for (cellX = 0; cellX < NUM_CELLS; cellX++) {
+            for (listIndex = 0; listIndex < 3; listIndex++) {
+                struct PackedCell *cell = &sPackedCells[cellZ][cellX][listIndex];
+                u32 length = surface_node_list_length(gStaticSurfacePartition[cellZ][cellX][listIndex].next);
+
+                cell->numBlocks = (length + PACK_WIDTH - 1) / PACK_WIDTH;
+                if (listIndex == SPATIAL_PARTITION_WALLS) {
+                    cell->start = numWalls;
+                    numWalls += cell->numBlocks;
+                    if (length > maxWalls) {
+                        maxWalls = length;
+                    }
+                } else {
+                    cell->start = numTris;
+                    numTris += cell->numBlocks;
+                }
+            }
+        }
+    }
+
+    if (numTris > sPackedTrisCapacity) {
+        sPackedTris = realloc(sPackedTris, numTris * sizeof(struct PackedTris));
+        sPackedTrisCapacity = numTris;
+    }
+    if (numWalls > sPackedWallsCapacity) {
+        sPackedWalls = realloc(sPackedWalls, numWalls * sizeof(struct PackedWalls));
+        sPackedWallsCapacity = numWalls;
+    }
+    if (maxWalls > sWallCandidatesCapacity) {
+        sWallCandidates = realloc(sWallCandidates, maxWalls * sizeof(struct SurfaceNode));
+        sWallCandidatesCapacity = maxWalls;
+    }
+
+    for (cellZ = 0; cellZ < NUM_CELLS; cellZ++) {
+        for (cellX = 0; cellX < NUM_CELLS; cellX++) {
+            for (listIndex = 0; listIndex < 3; listIndex++) {
+                struct PackedCell *cell = &sPackedCells[cellZ][cellX][listIndex];
+                struct SurfaceNode *node = gStaticSurfacePartition[cellZ][cellX][listIndex].next;
+                u32 i, j;
+
+                for (i = 0; i < cell->numBlocks; i++) {
+                    if (listIndex == SPATIAL_PARTITION_WALLS) {
+                        pack_walls(&sPackedWalls[cell->start + i], node);
+                    } else {
+                        pack_tris(&sPackedTris[cell->start + i], node, listIndex);
+                    }
+                    for (j = 0; j < PACK_WIDTH && node != NULL; j++) {
+                        node = node->next;
+                    }
+                }
+            }
+        }
+    }
+}
+#endif
@@ -5,8 +5,34 @@
 
 #include "types.h"
 
+// The N64 always uses the original 16x16 grid, ports only use a finer one when built with
+// COLLISION_CELLS
+#if (defined(TARGET_N64) || !defined(COLLISION_CELLS)) && !defined(VANILLA_COLLISION)
+#define VANILLA_COLLISION
+#endif
+
+#ifdef VANILLA_COLLISION
 #define LEVEL_BOUNDARY_MAX 0x2000
 #define CELL_SIZE          0x400
+#else
+// The finer grid covers four times the area, so geometry past the original boundary becomes
+// solid, and a query near a cell border can see different walls than on the N64
+#define LEVEL_BOUNDARY_MAX 0x4000
+#define CELL_SIZE          (2 * LEVEL_BOUNDARY_MAX / COLLISION_CELLS)
+#if COLLISION_CELLS < 16 || COLLISION_CELLS > 256 || (COLLISION_CELLS & (COLLISION_CELLS - 1)) != 0
+#error COLLISION_CELLS must be a power of two between 16 and 256
+#endif
+#endif
+
+#define NUM_CELLS       (2 * LEVEL_BOUNDARY_MAX / CELL_SIZE)
+#define NUM_CELLS_INDEX (NUM_CELLS - 1)
+
+#ifndef TARGET_N64
+// Static surfaces are also kept in packed per-cell arrays that are tested four at a time
+#define PACKED_SURFACES
+// find_floor remembers its results until the surfaces change
+#define FLOOR_CACHE
+#endif
 
 struct WallCollisionData
 {
@@ -18,6 +44,19 @@ struct WallCollisionData
     /*0x18*/ struct Surface *walls[4];
 };
 
+#ifdef FLOOR_CACHE
+#define FLOOR_CACHE_SIZE  256
+#define MAX_FLOOR_QUERIES 0x400
+
+// A position for find_floors, and the floor it found
+struct FloorQuery
+{
+    f32 x, y, z;
+    f32 height;
+    struct Surface *floor;
+};
+#endif
+
 struct FloorGeometry
 {
     f32 unused[4]; // possibly position data?
@@ -33,8 +72,16 @@ f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil);
 f32 find_floor_height_and_data(f32 xPos, f32 yPos, f32 zPos, struct FloorGeometry **floorGeo);
 f32 find_floor_height(f32 x, f32 y, f32 z);
 f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor);
+s32 dynamic_floors_in_range(f32 xPos, f32 zPos, f32 radius);
 f32 find_water_level(f32 x, f32 z);
 f32 find_poison_gas_level(f32 x, f32 z);
 void debug_surface_list_info(f32 xPos, f32 zPos);
+#ifdef PACKED_SURFACES
+void pack_static_surface_partition(void);
+#endif
+#ifdef FLOOR_CACHE
+void clear_floor_cache(void);
+void find_floors(struct FloorQuery *queries, s32 count);
+#endif
 
 #endif // SURFACE_COLLISION_H
@@ -17,12 +17,31 @@
 
 s32 unused8038BE90;
 
+#ifndef TARGET_N64
+#include <stdlib.h>
+#include <string.h>
+
+// Objects whose collision didn't move reuse their surfaces from the last time they were loaded
+#define OBJECT_SURFACE_CACHE
+// clear_dynamic_surfaces only clears the cells that something was added to
+#define DYNAMIC_CELL_TRACKING
+#endif
+
 /**
  * Partitions for course and object surfaces. The arrays represent
- * the 16x16 cells that each level is split into.
+ * the NUM_CELLS x NUM_CELLS cells that each level is split into.
+ */
+SpatialPartitionCell gStaticSurfacePartition[NUM_CELLS][NUM_CELLS];
+SpatialPartitionCell gDynamicSurfacePartition[NUM_CELLS][NUM_CELLS];
+
+#ifdef DYNAMIC_CELL_TRACKING
+/**
+ * Cells of gDynamicSurfacePartition that had an empty list added to since they were
+ * last cleared. A cell appears at most once per list.
  */
-SpatialPartitionCell gStaticSurfacePartition[16][16];
-SpatialPartitionCell gDynamicSurfacePartition[16][16];
+static u16 sDynamicCellsUsed[3 * NUM_CELLS * NUM_CELLS];
+static s32 sNumDynamicCellsUsed;
+#endif
 
 /**
  * Pools of data to contain either surface nodes or surfaces.
@@ -49,7 +68,7 @@ static struct SurfaceNode *alloc_surface_node(void) {
     //! A bounds check! If there's more surface nodes than 7000 allowed,
     //  we, um...
     // Perhaps originally just debug feedback?
-    if (gSurfaceNodesAllocated >= 7000) {
+    if (gSurfaceNodesAllocated >= SURFACE_NODE_POOL_SIZE) {
     }
 
     return node;
@@ -83,7 +102,11 @@ static struct Surface *alloc_surface(void) {
  * Iterates through the entire partition, clearing the surfaces.
  */
 static void clear_spatial_partition(SpatialPartitionCell *cells) {
-    register s32 i = 16 * 16;
+    register s32 i = NUM_CELLS * NUM_CELLS;
+
+#ifdef FLOOR_CACHE
+    clear_floor_cache();
+#endif
 
     while (i--) {
         (*cells)[SPATIAL_PARTITION_FLOORS].next = NULL;
@@ -143,6 +166,11 @@ static void add_surface_to_cell(s16 dynamic, s16 cellX, s16 cellZ, struct Surfac
 
     if (dynamic) {
         list = &gDynamicSurfacePartition[cellZ][cellX][listIndex];
+#ifdef DYNAMIC_CELL_TRACKING
+        if (list->next == NULL) {
+            sDynamicCellsUsed[sNumDynamicCellsUsed++] = cellZ * NUM_CELLS + cellX;
+        }
+#endif
     } else {
         list = &gStaticSurfacePartition[cellZ][cellX][listIndex];
     }
@@ -192,27 +220,34 @@ static s16 max_3(s16 a0, s16 a1, s16 a2) {
     return a0;
 }
 
+#ifdef VANILLA_COLLISION
+typedef s16 CellCoord;
+#else
+// Vertices past 0x4000 would wrap around in an s16 once moved into the extended range
+typedef s32 CellCoord;
+#endif
+
 /**
- * Every level is split into 16 * 16 cells of surfaces (to limit computing
- * time). This function determines the lower cell for a given x/z position.
+ * Every level is split into NUM_CELLS * NUM_CELLS cells of surfaces (to limit
+ * computing time). This function determines the lower cell for a given x/z position.
  * @param coord The coordinate to test
  */
-static s16 lower_cell_index(s16 coord) {
+static s16 lower_cell_index(CellCoord coord) {
     s16 index;
 
-    // Move from range [-0x2000, 0x2000) to [0, 0x4000)
-    coord += 0x2000;
+    // Move from range [-LEVEL_BOUNDARY_MAX, LEVEL_BOUNDARY_MAX) to [0, 2 * LEVEL_BOUNDARY_MAX)
+    coord += LEVEL_BOUNDARY_MAX;
     if (coord < 0) {
         coord = 0;
     }
 
-    // [0, 16)
-    index = coord / 0x400;
+    // [0, NUM_CELLS)
+    index = coord / CELL_SIZE;
 
     // Include extra cell if close to boundary
     //! Some wall checks are larger than the buffer, meaning wall checks can
     //  miss walls that are near a cell border.
-    if (coord % 0x400 < 50) {
+    if (coord % CELL_SIZE < 50) {
         index -= 1;
     }
 
@@ -220,36 +255,36 @@ static s16 lower_cell_index(s16 coord) {
         index = 0;
     }
 
-    // Potentially > 15, but since the upper index is <= 15, not exploitable
+    // Potentially > NUM_CELLS_INDEX, but since the upper index is <= NUM_CELLS_INDEX, not exploitable
     return index;
 }
 
 /**
- * Every level is split into 16 * 16 cells of surfaces (to limit computing
- * time). This function determines the upper cell for a given x/z position.
+ * Every level is split into NUM_CELLS * NUM_CELLS cells of surfaces (to limit
+ * computing time). This function determines the upper cell for a given x/z position.
  * @param coord The coordinate to test
  */
-static s16 upper_cell_index(s16 coord) {
+static s16 upper_cell_index(CellCoord coord) {
     s16 index;
 
-    // Move from range [-0x2000, 0x2000) to [0, 0x4000)
-    coord += 0x2000;
+    // Move from range [-LEVEL_BOUNDARY_MAX, LEVEL_BOUNDARY_MAX) to [0, 2 * LEVEL_BOUNDARY_MAX)
+    coord += LEVEL_BOUNDARY_MAX;
     if (coord < 0) {
         coord = 0;
     }
 
-    // [0, 16)
-    index = coord / 0x400;
+    // [0, NUM_CELLS)
+    index = coord / CELL_SIZE;
 
     // Include extra cell if close to boundary
     //! Some wall checks are larger than the buffer, meaning wall checks can
     //  miss walls that are near a cell border.
-    if (coord % 0x400 > 0x400 - 50) {
+    if (coord % CELL_SIZE > CELL_SIZE - 50) {
         index += 1;
     }
 
-    if (index > 15) {
-        index = 15;
+    if (index > NUM_CELLS_INDEX) {
+        index = NUM_CELLS_INDEX;
     }
 
     // Potentially < 0, but since lower index is >= 0, not exploitable
@@ -257,7 +292,7 @@ static s16 upper_cell_index(s16 coord) {
 }
 
 /**
- * Every level is split into 16x16 cells, this takes a surface, finds
+ * Every level is split into NUM_CELLS x NUM_CELLS cells, this takes a surface, finds
  * the appropriate cells (with a buffer), and adds the surface to those
  * cells.
  * @param surface The surface to check
@@ -274,6 +309,10 @@ static void add_surface(struct Surface *surface, s32 dynamic) {
     // cellY maybe? s32 instead of s16, though.
     UNUSED s32 unused3 = 0;
 
+#ifdef FLOOR_CACHE
+    clear_floor_cache();
+#endif
+
     minX = min_3(surface->vertex1[0], surface->vertex2[0], surface->vertex3[0]);
     minZ = min_3(surface->vertex1[2], surface->vertex2[2], surface->vertex3[2]);
     maxX = max_3(surface->vertex1[0], surface->vertex2[0], surface->vertex3[0]);
@@ -525,7 +564,7 @@ static void load_environmental_regions(s16 **data) {
  */
 void alloc_surface_pools(void) {
     sSurfacePoolSize = 2300;
-    sSurfaceNodePool = main_pool_alloc(7000 * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
+    sSurfaceNodePool = main_pool_alloc(SURFACE_NODE_POOL_SIZE * sizeof(struct SurfaceNode), MEMORY_POOL_LEFT);
     sSurfacePool = main_pool_alloc(sSurfacePoolSize * sizeof(struct Surface), MEMORY_POOL_LEFT);
 
     gCCMEnteredSlide = 0;
@@ -639,7 +678,35 @@ void load_area_terrain(s16 index, s16 *data, s8 *surfaceRooms, s16 *macroObjects
 
     gNumStaticSurfaceNodes = gSurfaceNodesAllocated;
     gNumStaticSurfaces = gSurfacesAllocated;
+
+#ifdef PACKED_SURFACES
+    pack_static_surface_partition();
+#endif
+}
+
+#ifdef DYNAMIC_CELL_TRACKING
+/**
+ * Clear the lists of the dynamic cells that were added to, which are usually far fewer
+ * than all of them.
+ */
+static void clear_used_dynamic_cells(void) {
+    SpatialPartitionCell *cells = &gDynamicSurfacePartition[0][0];
+    s32 i;
+
+#ifdef FLOOR_CACHE
+    clear_floor_cache();
+#endif
+
+    for (i = 0; i < sNumDynamicCellsUsed; i++) {
+        struct SurfaceNode *cell = cells[sDynamicCellsUsed[i]];
+
+        cell[SPATIAL_PARTITION_FLOORS].next = NULL;
+        cell[SPATIAL_PARTITION_CEILS].next = NULL;
+        cell[SPATIAL_PARTITION_WALLS].next = NULL;
+    }
+    sNumDynamicCellsUsed = 0;
 }
+#endif
 
 /**
  * If not in time stop, clear the surface partitions.
@@ -649,7 +716,11 @@ void clear_dynamic_surfaces(void) {
         gSurfacesAllocated = gNumStaticSurfaces;
         gSurfaceNodesAllocated = gNumStaticSurfaceNodes;
 
+#ifdef DYNAMIC_CELL_TRACKING
+        clear_used_dynamic_cells();
+#else
         clear_spatial_partition(&gDynamicSurfacePartition[0][0]);
+#endif
     }
 }
 
@@ -755,6 +826,80 @@ void load_object_surfaces(s16 **data, s16 *vertexData) {
 /**
  * Transform an object's vertices, reload them, and render the object.
  */
+#ifdef OBJECT_SURFACE_CACHE
+/**
+ * The surfaces an object produced the last time its collision was loaded, and what they
+ * were computed from. The vertices only depend on the collision data and the object's
+ * matrix, and the surfaces on those and its behavior, so while all three stay the same
+ * the surfaces can be copied instead of transformed and rebuilt.
+ */
+struct ObjectSurfaceCache {
+    s16 *collisionData;
+    const BehaviorScript *behavior;
+    Mat4 m;
+    struct Surface *surfaces;
+    s32 numSurfaces;
+    s32 capacity;
+};
+
+static struct ObjectSurfaceCache sObjectSurfaceCache[OBJECT_POOL_CAPACITY];
+
+/**
+ * Load the surfaces of gCurrentObject, from the cache if its matrix hasn't changed.
+ * Produces exactly the surfaces, in the same order, as transforming the vertices again.
+ */
+static void load_object_surfaces_cached(s16 **data, s16 *vertexData) {
+    struct Object *obj = gCurrentObject;
+    struct ObjectSurfaceCache *cache = NULL;
+    s32 firstSurface = gSurfacesAllocated;
+    s32 i;
+    Mat4 m;
+
+    if (obj >= &gObjectPool[0] && obj < &gObjectPool[OBJECT_POOL_CAPACITY]) {
+        cache = &sObjectSurfaceCache[obj - gObjectPool];
+
+        // Same as transform_object_vertices, which then finds the matrix already built
+        if (obj->header.gfx.throwMatrix == NULL) {
+            obj->header.gfx.throwMatrix = &obj->transform;
+            obj_build_transform_from_pos_and_angle(obj, O_POS_INDEX, O_FACE_ANGLE_INDEX);
+        }
+        obj_apply_scale_to_matrix(obj, m, obj->transform);
+
+        if (cache->collisionData == obj->collisionData && cache->behavior == obj->behavior
+            && memcmp(cache->m, m, sizeof(Mat4)) == 0) {
+            for (i = 0; i < cache->numSurfaces; i++) {
+                struct Surface *surface = alloc_surface();
+
+                *surface = cache->surfaces[i];
+                add_surface(surface, TRUE);
+            }
+            return;
+        }
+    }
+
+    transform_object_vertices(data, vertexData);
+
+    // TERRAIN_LOAD_CONTINUE acts as an "end" to the terrain data.
+    while (**data != TERRAIN_LOAD_CONTINUE) {
+        load_object_surfaces(data, vertexData);
+    }
+
+    if (cache != NULL) {
+        s32 numSurfaces = gSurfacesAllocated - firstSurface;
+
+        if (numSurfaces > cache->capacity) {
+            cache->surfaces = realloc(cache->surfaces, numSurfaces * sizeof(struct Surface));
+            cache->capacity = numSurfaces;
+        }
+        memcpy(cache->surfaces, &sSurfacePool[firstSurface], numSurfaces * sizeof(struct Surface));
+        cache->numSurfaces = numSurfaces;
+        cache->collisionData = obj->collisionData;
+        cache->behavior = obj->behavior;
+        memcpy(cache->m, m, sizeof(Mat4));
+    }
+}
+#endif
+
 void load_object_collision_model(void) {
     UNUSED s32 unused;
     s16 vertexData[600];
@@ -779,12 +924,16 @@ void load_object_collision_model(void) {
     if (!(gTimeStopState & TIME_STOP_ACTIVE) && marioDist < tangibleDist
         && !(gCurrentObject->activeFlags & ACTIVE_FLAG_IN_DIFFERENT_ROOM)) {
         collisionData++;
+#ifdef OBJECT_SURFACE_CACHE
+        load_object_surfaces_cached(&collisionData, vertexData);
+#else
         transform_object_vertices(&collisionData, vertexData);
 
         // TERRAIN_LOAD_CONTINUE acts as an "end" to the terrain data.
         while (*collisionData != TERRAIN_LOAD_CONTINUE) {
             load_object_surfaces(&collisionData, vertexData);
         }
+#endif
     }
 
     if (marioDist < gCurrentObject->oDrawingDistance) {
@@ -4,6 +4,7 @@
 #include <PR/ultratypes.h>
 
 #include "types.h"
+#include "surface_collision.h"
 
 struct SurfaceNode
 {
@@ -20,11 +21,18 @@ enum
 
 typedef struct SurfaceNode SpatialPartitionCell[3];
 
+#ifdef VANILLA_COLLISION
+#define SURFACE_NODE_POOL_SIZE 7000
+#else
+// Large surfaces are listed in more of the finer cells
+#define SURFACE_NODE_POOL_SIZE (7000 * (0x400 / CELL_SIZE) * (0x400 / CELL_SIZE))
+#endif
+
 // Needed for bs bss reordering memes.
 extern s32 unused8038BE90;
 
-extern SpatialPartitionCell gStaticSurfacePartition[16][16];
-extern SpatialPartitionCell gDynamicSurfacePartition[16][16];
+extern SpatialPartitionCell gStaticSurfacePartition[NUM_CELLS][NUM_CELLS];
+extern SpatialPartitionCell gDynamicSurfacePartition[NUM_CELLS][NUM_CELLS];
 extern struct SurfaceNode *sSurfaceNodePool;
 extern struct Surface *sSurfacePool;
 extern s16 sSurfacePoolSize;
@@ -13,6 +13,13 @@
 #include "geo_misc.h"
 #include "rendering_graph_node.h"
 #include "object_list_processor.h"
+#include "game_init.h"
+
+#ifndef TARGET_N64
+// Keep the vertices of rotating quads (water, mist, lava) in persistent buffers and
+// only rewrite them when the height, rotation or color changed since the last frame.
+#define MOVTEX_PERSISTENT_QUADS
+#endif
 
 /**
  * This file contains functions for generating display lists with moving textures
@@ -394,6 +401,54 @@ struct MovtexQuad {
 /// Variable for a little optimization: only set the texture when it differs from the previous texture
 s16 gMovetexLastTextureId;
 
+#ifdef MOVTEX_PERSISTENT_QUADS
+#define MOVTEX_QUAD_CACHE_SIZE 64
+
+/**
+ * Vertices of a MovtexQuad kept alive across frames. Since quads are static level data,
+ * the quad pointer identifies the mesh; the remaining fields are what the vertices
+ * were last generated from.
+ */
+struct MovtexQuadCacheEntry {
+    struct MovtexQuad *quad;
+    u32 frame;
+    s16 y;
+    s16 rot;
+    s8 vtxColor;
+    Vtx verts[4];
+};
+
+static struct MovtexQuadCacheEntry sMovtexQuadCache[MOVTEX_QUAD_CACHE_SIZE];
+
+/**
+ * Returns the cached vertex buffer for a quad, or NULL if the vertices have to be
+ * regenerated into a fresh buffer. Sets *upToDate when the buffer already holds the
+ * vertices for this y, rotation and color.
+ */
+static Vtx *movtex_quad_cached_verts(struct MovtexQuad *quad, s16 y, s16 rot, s32 *upToDate) {
+    struct MovtexQuadCacheEntry *entry =
+        &sMovtexQuadCache[((uintptr_t) quad / sizeof(struct MovtexQuad)) % MOVTEX_QUAD_CACHE_SIZE];
+
+    *upToDate = entry->quad == quad && entry->y == y && entry->rot == rot
+                && entry->vtxColor == gMovtexVtxColor;
+    if (*upToDate) {
+        entry->frame = gGlobalTimer;
+        return entry->verts;
+    }
+    // The buffer is still referenced by a display list built this frame, so it can't be
+    // overwritten. This happens when the same quad is drawn twice at different heights.
+    if (entry->quad != NULL && entry->frame == gGlobalTimer) {
+        return NULL;
+    }
+    entry->quad = quad;
+    entry->frame = gGlobalTimer;
+    entry->y = y;
+    entry->rot = rot;
+    entry->vtxColor = gMovtexVtxColor;
+    return entry->verts;
+}
+#endif
+
 /**
  * Generates and returns a display list for a single MovtexQuad at height y.
  */
@@ -412,7 +467,12 @@ Gfx *movtex_gen_from_quad(s16 y, struct MovtexQuad *quad) {
     s16 rotDir = quad->rotDir;
     s16 alpha = quad->alpha;
     s16 textureId = quad->textureId;
+#ifdef MOVTEX_PERSISTENT_QUADS
+    Vtx *verts;
+    s32 upToDate;
+#else
     Vtx *verts = alloc_display_list(4 * sizeof(*verts));
+#endif
     Gfx *gfxHead;
     Gfx *gfx;
 
@@ -422,6 +482,24 @@ Gfx *movtex_gen_from_quad(s16 y, struct MovtexQuad *quad) {
         gfxHead = alloc_display_list(8 * sizeof(*gfxHead));
     }
 
+#ifdef MOVTEX_PERSISTENT_QUADS
+    if (gfxHead == NULL) {
+        return NULL;
+    }
+    if (gMovtexCounter != gMovtexCounterPrev) {
+        quad->rot += rotspeed;
+    }
+    rot = quad->rot;
+    verts = movtex_quad_cached_verts(quad, y, rot, &upToDate);
+    if (verts == NULL) {
+        upToDate = FALSE;
+        verts = alloc_display_list(4 * sizeof(*verts));
+        if (verts == NULL) {
+            return NULL;
+        }
+    }
+    gfx = gfxHead;
+#else
     if (gfxHead == NULL || verts == NULL) {
         return NULL;
     }
@@ -430,6 +508,23 @@ Gfx *movtex_gen_from_quad(s16 y, struct MovtexQuad *quad) {
         quad->rot += rotspeed;
     }
     rot = quad->rot;
+#endif
+#ifdef MOVTEX_PERSISTENT_QUADS
+    // Vertices from a previous frame are still valid
+    if (!upToDate) {
+        if (rotDir == ROTATE_CLOCKWISE) {
+            movtex_make_quad_vertex(verts, 0, x1, y, z1, rot, 0, scale, alpha);
+            movtex_make_quad_vertex(verts, 1, x2, y, z2, rot, 16384, scale, alpha);
+            movtex_make_quad_vertex(verts, 2, x3, y, z3, rot, -32768, scale, alpha);
+            movtex_make_quad_vertex(verts, 3, x4, y, z4, rot, -16384, scale, alpha);
+        } else { // ROTATE_COUNTER_CLOCKWISE
+            movtex_make_quad_vertex(verts, 0, x1, y, z1, rot, 0, scale, alpha);
+            movtex_make_quad_vertex(verts, 1, x2, y, z2, rot, -16384, scale, alpha);
+            movtex_make_quad_vertex(verts, 2, x3, y, z3, rot, -32768, scale, alpha);
+            movtex_make_quad_vertex(verts, 3, x4, y, z4, rot, 16384, scale, alpha);
+        }
+    }
+#else
     if (rotDir == ROTATE_CLOCKWISE) {
         movtex_make_quad_vertex(verts, 0, x1, y, z1, rot, 0, scale, alpha);
         movtex_make_quad_vertex(verts, 1, x2, y, z2, rot, 16384, scale, alpha);
@@ -441,6 +536,7 @@ Gfx *movtex_gen_from_quad(s16 y, struct MovtexQuad *quad) {
         movtex_make_quad_vertex(verts, 2, x3, y, z3, rot, -32768, scale, alpha);
         movtex_make_quad_vertex(verts, 3, x4, y, z4, rot, 16384, scale, alpha);
     }
+#endif
 
     // Only add commands to change the texture when necessary
     if (textureId != gMovetexLastTextureId) {
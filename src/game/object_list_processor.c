@@ -566,6 +566,56 @@ void update_terrain_objects(void) {
     gObjectCounter = update_objects_in_list(&gObjectLists[OBJ_LIST_SURFACE]);
 }
 
+#ifdef FLOOR_CACHE
+// A quarter of the floor cache, so that the batch neither evicts much of itself nor leaves
+// no room for the floors of the objects that move
+#define MAX_FLOOR_PREFETCHES (FLOOR_CACHE_SIZE / 4)
+
+// Where each object of the pool was when the floors were last prefetched
+static Vec3f sPrefetchObjectPos[OBJECT_POOL_CAPACITY];
+
+/**
+ * Objects that didn't move during the last frame mostly look for the floor right where they
+ * are, so find those floors in one batch once the surface objects have loaded their
+ * collision, and the find_floor calls of the behaviors (and of the shadows) hit the cache.
+ */
+static void prefetch_object_floors(void) {
+    static struct FloorQuery queries[MAX_FLOOR_PREFETCHES];
+    s32 count = 0;
+    s32 listIndex;
+    s32 i = 2;
+
+    while ((listIndex = sObjectListUpdateOrder[i]) != -1) {
+        struct ObjectNode *objList = &gObjectLists[listIndex];
+        struct ObjectNode *node;
+
+        for (node = objList->next; node != objList; node = node->next) {
+            struct Object *obj = (struct Object *) node;
+            u32 slot = obj - gObjectPool;
+            f32 *prevPos;
+
+            if (!(obj->activeFlags & ACTIVE_FLAG_ACTIVE) || slot >= OBJECT_POOL_CAPACITY) {
+                continue;
+            }
+            prevPos = sPrefetchObjectPos[slot];
+            if (count < MAX_FLOOR_PREFETCHES && obj->oPosX == prevPos[0] && obj->oPosY == prevPos[1]
+                && obj->oPosZ == prevPos[2]) {
+                queries[count].x = obj->oPosX;
+                queries[count].y = obj->oPosY;
+                queries[count].z = obj->oPosZ;
+                count++;
+            }
+            prevPos[0] = obj->oPosX;
+            prevPos[1] = obj->oPosY;
+            prevPos[2] = obj->oPosZ;
+        }
+        i += 1;
+    }
+
+    find_floors(queries, count);
+}
+#endif
+
 /**
  * Update all other object lists besides spawner and surface objects, using
  * the order specified by sObjectListUpdateOrder.
@@ -575,6 +625,9 @@ void update_non_terrain_objects(void) {
     s32 listIndex;
 
     s32 i = 2;
+#ifdef FLOOR_CACHE
+    prefetch_object_floors();
+#endif
     while ((listIndex = sObjectListUpdateOrder[i]) != -1) {
         gObjectCounter += update_objects_in_list(&gObjectLists[listIndex]);
         i += 1;
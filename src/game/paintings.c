@@ -17,6 +17,15 @@
 #include "save_file.h"
 #include "segment2.h"
 
+#ifndef TARGET_N64
+// Compute the ripple distances of several vertices at once
+#define PAINTING_BATCHED_MESH
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PAINTING_MESH_SSE2
+#endif
+#endif
+
 /**
  * @file paintings.c
  *
@@ -653,6 +662,37 @@ s16 ripple_if_movable(struct Painting *painting, s16 movable, s16 posX, s16 posY
     return rippleZ;
 }
 
+#ifdef PAINTING_BATCHED_MESH
+/**
+ * Number of vertices painting_generate_mesh processes per batch.
+ */
+#define PAINTING_MESH_BATCH 4
+
+/**
+ * Compute how far the ripple must travel to reach each of the PAINTING_MESH_BATCH points (posX, posY).
+ * Same as the distance part of calculate_ripple_at_point, but for a whole batch.
+ */
+static void painting_batch_ripple_distances(f32 *posX, f32 *posY, f32 rippleX, f32 rippleY,
+                                            f32 dispersionFactor, f32 *rippleDistance) {
+#ifdef PAINTING_MESH_SSE2
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(posX), _mm_set1_ps(rippleX));
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(posY), _mm_set1_ps(rippleY));
+    __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+    _mm_storeu_ps(rippleDistance, _mm_div_ps(dist, _mm_set1_ps(dispersionFactor)));
+#else
+    s32 i;
+
+    for (i = 0; i < PAINTING_MESH_BATCH; i++) {
+        f32 dx = posX[i] - rippleX;
+        f32 dy = posY[i] - rippleY;
+
+        rippleDistance[i] = sqrtf(dx * dx + dy * dy) / dispersionFactor;
+    }
+#endif
+}
+#endif
+
 /**
  * Allocates and generates a mesh for the rippling painting effect by modifying the passed in `mesh`
  * based on the painting's current ripple state.
@@ -674,10 +714,50 @@ s16 ripple_if_movable(struct Painting *painting, s16 movable, s16 posX, s16 posY
  */
 void painting_generate_mesh(struct Painting *painting, s16 *mesh, s16 numTris) {
     s16 i;
+#ifdef PAINTING_BATCHED_MESH
+    s16 j;
+    s16 batchSize;
+    f32 posX[PAINTING_MESH_BATCH];
+    f32 posY[PAINTING_MESH_BATCH];
+    f32 rippleDistance[PAINTING_MESH_BATCH];
+#endif
 
     gPaintingMesh = mem_pool_alloc(gEffectsMemoryPool, numTris * sizeof(struct PaintingMeshVertex));
     if (gPaintingMesh == NULL) {
     }
+#ifdef PAINTING_BATCHED_MESH
+    // Same result as the loop below, but the distance to the ripple origin is computed for a batch of
+    // vertices at a time, and the cosine is only evaluated for vertices the ripple has reached.
+    for (i = 0; i < numTris; i += PAINTING_MESH_BATCH) {
+        batchSize = MIN(PAINTING_MESH_BATCH, numTris - i);
+        for (j = 0; j < PAINTING_MESH_BATCH; j++) {
+            if (j < batchSize) {
+                posX[j] = mesh[(i + j) * 3 + 1];
+                posY[j] = mesh[(i + j) * 3 + 2];
+                posX[j] *= painting->size / PAINTING_SIZE;
+                posY[j] *= painting->size / PAINTING_SIZE;
+            } else {
+                posX[j] = painting->rippleX;
+                posY[j] = painting->rippleY;
+            }
+        }
+        painting_batch_ripple_distances(posX, posY, painting->rippleX, painting->rippleY,
+                                        painting->dispersionFactor, rippleDistance);
+
+        for (j = 0; j < batchSize; j++) {
+            struct PaintingMeshVertex *vtx = &gPaintingMesh[i + j];
+
+            vtx->pos[0] = mesh[(i + j) * 3 + 1];
+            vtx->pos[1] = mesh[(i + j) * 3 + 2];
+            vtx->pos[2] = 0;
+            if (mesh[(i + j) * 3 + 3] && painting->rippleTimer >= rippleDistance[j]) {
+                vtx->pos[2] = round_float(painting->currRippleMag
+                                          * cosf(painting->currRippleRate * (2 * M_PI)
+                                                 * (painting->rippleTimer - rippleDistance[j])));
+            }
+        }
+    }
+#else
     // accesses are off by 1 since the first entry is the number of vertices
     for (i = 0; i < numTris; i++) {
         gPaintingMesh[i].pos[0] = mesh[i * 3 + 1];
@@ -687,6 +767,7 @@ void painting_generate_mesh(struct Painting *painting, s16 *mesh, s16 numTris) {
         gPaintingMesh[i].pos[2] = ripple_if_movable(painting, mesh[i * 3 + 3],
                                                     gPaintingMesh[i].pos[0], gPaintingMesh[i].pos[1]);
     }
+#endif
 }
 
 /**
@@ -728,6 +809,15 @@ void painting_calculate_triangle_normals(s16 *mesh, s16 numVtx, s16 numTris) {
         f32 y2 = gPaintingMesh[v2].pos[1];
         f32 z2 = gPaintingMesh[v2].pos[2];
 
+#ifdef PAINTING_BATCHED_MESH
+        // Triangles the ripple hasn't displaced are flat, so only the z component is nonzero
+        if (z0 == 0.0f && z1 == 0.0f && z2 == 0.0f) {
+            gPaintingTriNorms[i][0] = 0.0f;
+            gPaintingTriNorms[i][1] = 0.0f;
+            gPaintingTriNorms[i][2] = (x1 - x0) * (y2 - y1) - (y1 - y0) * (x2 - x1);
+            continue;
+        }
+#endif
         // Cross product to find each triangle's normal vector
         gPaintingTriNorms[i][0] = (y1 - y0) * (z2 - z1) - (z1 - z0) * (y2 - y1);
         gPaintingTriNorms[i][1] = (z1 - z0) * (x2 - x1) - (x1 - x0) * (z2 - z1);
@@ -792,6 +882,16 @@ void painting_average_vertex_normals(s16 *neighborTris, s16 numVtx) {
         // Move to the next vertex's entry
         entry += neighbors + 1;
 
+#ifdef PAINTING_BATCHED_MESH
+        // The averaged normal of a flat region points straight out of the painting, skip normalizing it
+        if (nx == 0.0f && ny == 0.0f) {
+            gPaintingMesh[i].norm[0] = 0;
+            gPaintingMesh[i].norm[1] = 0;
+            gPaintingMesh[i].norm[2] = (nz > 0.0f) ? 127 : ((nz < 0.0f) ? -128 : 0);
+            continue;
+        }
+#endif
+
         // average the surface normals from each neighboring tri
         nx /= neighbors;
         ny /= neighbors;
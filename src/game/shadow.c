@@ -1,6 +1,7 @@
 #include <PR/ultratypes.h>
 #include <PR/gbi.h>
 #include <math.h>
+#include <string.h>
 
 #include "engine/math_util.h"
 #include "engine/surface_collision.h"
@@ -16,6 +17,8 @@
 #ifndef TARGET_N64
 // Avoid Z-fighting
 #define find_floor_height_and_data 0.4 + find_floor_height_and_data
+// Reuse the vertices of shadows whose object and floor have not changed
+#define SHADOW_CACHE
 #endif
 
 /**
@@ -111,6 +114,53 @@ s8 gMarioOnIceOrCarpet;
 s8 sMarioOnFlyingCarpet;
 s16 sSurfaceTypeBelowShadow;
 
+#ifdef SHADOW_CACHE
+/**
+ * Number of objects whose shadows can be cached at once.
+ */
+#define SHADOW_CACHE_SIZE 256
+
+/**
+ * A shadow built on a previous frame, along with everything it was built from.
+ * Only shadows that depend solely on level geometry are cached, so as long as the
+ * inputs match and no dynamic floors are nearby, the vertices can be reused as is.
+ */
+struct ShadowCacheEntry {
+    /* The graph node object the shadow belongs to. */
+    struct GraphNodeObject *owner;
+    f32 xPos;
+    f32 yPos;
+    f32 zPos;
+    /* Water level at the center of the shadow. */
+    f32 waterLevel;
+    s16 shadowScale;
+    /* Face yaw of the object, used by rectangular shadows. */
+    s16 faceYaw;
+    s16 levelNum;
+    s16 areaIndex;
+    u8 solidity;
+    s8 shadowType;
+    /* Resulting global state. */
+    s16 surfaceTypeBelowShadow;
+    s8 aboveWaterOrLava;
+    s8 onIceOrCarpet;
+    /* Whether a shadow was drawn at all. */
+    s8 hasShadow;
+    s8 shadowVertexType;
+    s8 shadowShape;
+    Vtx verts[9];
+};
+
+struct ShadowCacheEntry sShadowCache[SHADOW_CACHE_SIZE];
+
+/**
+ * The vertices and shape of the shadow last passed to add_shadow_to_display_list.
+ */
+Vtx *sLastShadowVerts;
+s8 sLastShadowVertexType;
+s8 sLastShadowShape;
+#endif
+
 /**
  * Let (oldZ, oldX) be the relative coordinates of a point on a rectangle,
  * assumed to be centered at the origin on the standard SM64 X-Z plane. This
@@ -466,6 +516,11 @@ void make_shadow_vertex(Vtx *vertices, s8 index, struct Shadow s, s8 shadowVerte
  * Add a shadow to the given display list.
  */
 void add_shadow_to_display_list(Gfx *displayListHead, Vtx *verts, s8 shadowVertexType, s8 shadowShape) {
+#ifdef SHADOW_CACHE
+    sLastShadowVerts = verts;
+    sLastShadowVertexType = shadowVertexType;
+    sLastShadowShape = shadowShape;
+#endif
     switch (shadowShape) {
         case SHADOW_SHAPE_CIRCLE:
             gSPDisplayList(displayListHead++, dl_shadow_circle);
@@ -847,6 +902,97 @@ Gfx *create_shadow_hardcoded_rectangle(f32 xPos, f32 yPos, f32 zPos, UNUSED s16
     return create_shadow_rectangle(halfWidth, halfLength, -distFromShadow, solidity);
 }
 
+#ifdef SHADOW_CACHE
+/**
+ * Return the cache entry for the object currently being rendered, or NULL if
+ * its shadow cannot be cached.
+ */
+static struct ShadowCacheEntry *shadow_cache_entry(f32 xPos, f32 zPos, s16 shadowScale, s8 shadowType) {
+    struct GraphNodeObject *owner = gCurGraphNodeObject;
+
+    // The player's shadow depends on its animation and the flying carpet, and shadows of held
+    // objects are positioned using the holder's transform.
+    if (owner == NULL || shadowType == SHADOW_CIRCLE_PLAYER || gCurGraphNodeHeldObject != NULL) {
+        return NULL;
+    }
+    // Any floor query of the shadow stays within shadowScale of its center.
+    if (dynamic_floors_in_range(xPos, zPos, shadowScale)) {
+        return NULL;
+    }
+    return &sShadowCache[((uintptr_t) owner / sizeof(struct Object)) % SHADOW_CACHE_SIZE];
+}
+
+/**
+ * Return whether the cached shadow in `entry` was built from these parameters.
+ */
+static s32 shadow_cache_matches(struct ShadowCacheEntry *entry, f32 xPos, f32 yPos, f32 zPos,
+                                f32 waterLevel, s16 shadowScale, u8 solidity, s8 shadowType) {
+    return entry->owner == gCurGraphNodeObject && entry->xPos == xPos && entry->yPos == yPos
+           && entry->zPos == zPos && entry->waterLevel == waterLevel
+           && entry->shadowScale == shadowScale && entry->solidity == solidity
+           && entry->shadowType == shadowType
+           && entry->faceYaw == ((struct Object *) gCurGraphNodeObject)->oFaceAngleYaw
+           && entry->levelNum == gCurrLevelNum && entry->areaIndex == gCurrAreaIndex;
+}
+
+/**
+ * Rebuild a shadow display list from a cache entry, restoring the global state the
+ * original build left behind.
+ */
+static Gfx *shadow_cache_replay(struct ShadowCacheEntry *entry) {
+    s32 numVerts = (entry->shadowVertexType == SHADOW_WITH_9_VERTS) ? 9 : 4;
+    Vtx *verts;
+    Gfx *displayList;
+
+    gShadowAboveWaterOrLava = entry->aboveWaterOrLava;
+    gMarioOnIceOrCarpet = entry->onIceOrCarpet;
+    sMarioOnFlyingCarpet = 0;
+    sSurfaceTypeBelowShadow = entry->surfaceTypeBelowShadow;
+
+    if (!entry->hasShadow) {
+        return NULL;
+    }
+
+    verts = alloc_display_list(numVerts * sizeof(Vtx));
+    displayList = alloc_display_list(5 * sizeof(Gfx));
+    if (verts == NULL || displayList == NULL) {
+        return NULL;
+    }
+
+    memcpy(verts, entry->verts, numVerts * sizeof(Vtx));
+    add_shadow_to_display_list(displayList, verts, entry->shadowVertexType, entry->shadowShape);
+    return displayList;
+}
+
+/**
+ * Save a freshly built shadow into `entry`.
+ */
+static void shadow_cache_store(struct ShadowCacheEntry *entry, Gfx *displayList, f32 xPos, f32 yPos,
+                               f32 zPos, f32 waterLevel, s16 shadowScale, u8 solidity, s8 shadowType) {
+    entry->owner = gCurGraphNodeObject;
+    entry->xPos = xPos;
+    entry->yPos = yPos;
+    entry->zPos = zPos;
+    entry->waterLevel = waterLevel;
+    entry->shadowScale = shadowScale;
+    entry->faceYaw = ((struct Object *) gCurGraphNodeObject)->oFaceAngleYaw;
+    entry->levelNum = gCurrLevelNum;
+    entry->areaIndex = gCurrAreaIndex;
+    entry->solidity = solidity;
+    entry->shadowType = shadowType;
+    entry->surfaceTypeBelowShadow = sSurfaceTypeBelowShadow;
+    entry->aboveWaterOrLava = gShadowAboveWaterOrLava;
+    entry->onIceOrCarpet = gMarioOnIceOrCarpet;
+    entry->hasShadow = (displayList != NULL);
+    if (entry->hasShadow) {
+        entry->shadowVertexType = sLastShadowVertexType;
+        entry->shadowShape = sLastShadowShape;
+        memcpy(entry->verts, sLastShadowVerts,
+               ((sLastShadowVertexType == SHADOW_WITH_9_VERTS) ? 9 : 4) * sizeof(Vtx));
+    }
+}
+#endif
+
 /**
  * Create a shadow at the absolute position given, with the given parameters.
  * Return a pointer to the display list representing the shadow.
@@ -855,6 +1001,20 @@ Gfx *create_shadow_below_xyz(f32 xPos, f32 yPos, f32 zPos, s16 shadowScale, u8 s
                              s8 shadowType) {
     Gfx *displayList = NULL;
     struct Surface *pfloor;
+#ifdef SHADOW_CACHE
+    struct ShadowCacheEntry *cacheEntry = shadow_cache_entry(xPos, zPos, shadowScale, shadowType);
+    f32 waterLevel = 0.0f;
+
+    // Uncacheable shadows don't need the water level here
+    if (cacheEntry != NULL) {
+        waterLevel = find_water_level(xPos, zPos);
+    }
+    if (cacheEntry != NULL
+        && shadow_cache_matches(cacheEntry, xPos, yPos, zPos, waterLevel, shadowScale, shadowSolidity,
+                                shadowType)) {
+        return shadow_cache_replay(cacheEntry);
+    }
+#endif
     find_floor(xPos, yPos, zPos, &pfloor);
 
     gShadowAboveWaterOrLava = FALSE;
@@ -898,5 +1058,11 @@ Gfx *create_shadow_below_xyz(f32 xPos, f32 yPos, f32 zPos, s16 shadowScale, u8 s
                                                             shadowSolidity, shadowType);
             break;
     }
+#ifdef SHADOW_CACHE
+    if (cacheEntry != NULL) {
+        shadow_cache_store(cacheEntry, displayList, xPos, yPos, zPos, waterLevel, shadowScale,
+                           shadowSolidity, shadowType);
+    }
+#endif
     return displayList;
 }
@@ -12,6 +12,8 @@
 
 #ifndef TARGET_N64
 #define BETTER_SKYBOX_POSITION_PRECISION
+// Only rebuild the tile grid when the camera moves onto a different set of tiles
+#define SKYBOX_CACHED_TILE_GRID
 #endif
 
 /**
@@ -221,15 +223,32 @@ static int get_top_left_tile_idx(s8 player) {
     return tileRow * SKYBOX_COLS + tileCol;
 }
 
+#ifdef SKYBOX_CACHED_TILE_GRID
 /**
- * Generates vertices for the skybox tile.
+ * The tile grid display list last built for each player, along with its vertices.
+ * The grid only depends on the upper left tile, the image and the color, so the
+ * per-frame display list just reuses it with a new ortho matrix.
+ */
+struct SkyboxTileGrid {
+    s32 upperLeftTile;
+    s8 background;
+    s8 colorIndex;
+    s8 valid;
+    Vtx verts[3 * 3][4];
+    Gfx dlist[(3 * 3) * 7 + 1];
+};
+
+struct SkyboxTileGrid sSkyboxTileGrids[2];
+#endif
+
+/**
+ * Fills `verts` with the 4 vertices of the skybox tile.
  *
  * @param tileIndex The index into the 32x32 sections of the whole skybox image. The index is converted
  *                  into an x and y by modulus and division by SKYBOX_COLS. x and y are then scaled by
  *                  SKYBOX_TILE_WIDTH to get a point in world space.
  */
-Vtx *make_skybox_rect(s32 tileIndex, s8 colorIndex) {
-    Vtx *verts = alloc_display_list(4 * sizeof(*verts));
+void fill_skybox_rect(Vtx *verts, s32 tileIndex, s8 colorIndex) {
     s16 x = tileIndex % SKYBOX_COLS * SKYBOX_TILE_WIDTH;
     s16 y = SKYBOX_HEIGHT - tileIndex / SKYBOX_COLS * SKYBOX_TILE_HEIGHT;
 
@@ -244,6 +263,15 @@ Vtx *make_skybox_rect(s32 tileIndex, s8 colorIndex) {
                     sSkyboxColors[colorIndex][2], 255);
     } else {
     }
+}
+
+/**
+ * Generates vertices for the skybox tile.
+ */
+Vtx *make_skybox_rect(s32 tileIndex, s8 colorIndex) {
+    Vtx *verts = alloc_display_list(4 * sizeof(*verts));
+
+    fill_skybox_rect(verts, tileIndex, colorIndex);
     return verts;
 }
 
@@ -270,6 +298,46 @@ void draw_skybox_tile_grid(Gfx **dlist, s8 background, s8 player, s8 colorIndex)
     }
 }
 
+#ifdef SKYBOX_CACHED_TILE_GRID
+/**
+ * Returns the display list drawing the 3x3 tile grid for the player's current tiles, only rebuilding
+ * it and its vertices if the upper left tile, image or color changed since the last frame.
+ */
+Gfx *get_cached_skybox_tile_grid(s8 background, s8 player, s8 colorIndex) {
+    struct SkyboxTileGrid *grid = &sSkyboxTileGrids[player];
+    s32 upperLeftTile = sSkyBoxInfo[player].upperLeftTile;
+    Gfx *dlist = grid->dlist;
+    s32 row;
+    s32 col;
+
+    if (grid->valid && grid->upperLeftTile == upperLeftTile && grid->background == background
+        && grid->colorIndex == colorIndex) {
+        return grid->dlist;
+    }
+
+    for (row = 0; row < 3; row++) {
+        for (col = 0; col < 3; col++) {
+            s32 tileIndex = upperLeftTile + row * SKYBOX_COLS + col;
+            const u8 *const texture =
+                (*(SkyboxTexture *) segmented_to_virtual(sSkyboxTextures[background]))[tileIndex];
+            Vtx *vertices = grid->verts[row * 3 + col];
+
+            fill_skybox_rect(vertices, tileIndex, colorIndex);
+            gLoadBlockTexture(dlist++, 32, 32, G_IM_FMT_RGBA, texture);
+            gSPVertex(dlist++, VIRTUAL_TO_PHYSICAL(vertices), 4, 0);
+            gSPDisplayList(dlist++, dl_draw_quad_verts_0123);
+        }
+    }
+    gSPEndDisplayList(dlist);
+
+    grid->upperLeftTile = upperLeftTile;
+    grid->background = background;
+    grid->colorIndex = colorIndex;
+    grid->valid = TRUE;
+    return grid->dlist;
+}
+#endif
+
 void *create_skybox_ortho_matrix(s8 player) {
     f32 left = sSkyBoxInfo[player].scaledX;
     f32 right = sSkyBoxInfo[player].scaledX + SCREEN_WIDTH;
@@ -299,7 +367,11 @@ void *create_skybox_ortho_matrix(s8 player) {
  * Creates the skybox's display list, then draws the 3x3 grid of tiles.
  */
 Gfx *init_skybox_display_list(s8 player, s8 background, s8 colorIndex) {
+#ifdef SKYBOX_CACHED_TILE_GRID
+    s32 dlCommandCount = 5 + 1; // 5 for the start and end, plus a call to the cached tiles
+#else
     s32 dlCommandCount = 5 + (3 * 3) * 7; // 5 for the start and end, plus 9 skybox tiles
+#endif
     void *skybox = alloc_display_list(dlCommandCount * sizeof(Gfx));
     Gfx *dlist = skybox;
 
@@ -311,7 +383,11 @@ Gfx *init_skybox_display_list(s8 player, s8 background, s8 colorIndex) {
         gSPDisplayList(dlist++, dl_skybox_begin);
         gSPMatrix(dlist++, VIRTUAL_TO_PHYSICAL(ortho), G_MTX_PROJECTION | G_MTX_MUL | G_MTX_NOPUSH);
         gSPDisplayList(dlist++, dl_skybox_tile_tex_settings);
+#ifdef SKYBOX_CACHED_TILE_GRID
+        gSPDisplayList(dlist++, get_cached_skybox_tile_grid(background, player, colorIndex));
+#else
         draw_skybox_tile_grid(&dlist, background, player, colorIndex);
+#endif
         gSPDisplayList(dlist++, dl_skybox_end);
         gSPEndDisplayList(dlist);
     }
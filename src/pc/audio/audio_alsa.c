@@ -52,7 +52,7 @@ static bool audio_alsa_init(void) {
 	snd_pcm_hw_params_t *params;
 	snd_pcm_uframes_t frames;
 
-	rate 	 = 32000;
+	rate 	 = audio_output_frequency;
 	channels = 2;
 
 	/* Open the PCM device in playback mode */
@@ -83,7 +83,7 @@ static bool audio_alsa_init(void) {
 	if ((pcm = snd_pcm_hw_params_set_rate_near(pcm_handle, params, &rate, 0)) < 0)
 		printf("ERROR: Can't set rate. %s\n", snd_strerror(pcm));
 
-	alsa_buffer_size = 1600 + 528 + 544; // five audio buffers from the game
+	alsa_buffer_size = AUDIO_FRAMES_AT_OUTPUT_RATE(1600 + 528 + 544); // five audio buffers from the game
 	if ((pcm = snd_pcm_hw_params_set_buffer_size_near(pcm_handle, params, &alsa_buffer_size)) < 0)
 		printf("ERROR: Can't set buffer size. %s\n", snd_strerror(pcm));
 
@@ -133,7 +133,7 @@ static int audio_alsa_buffered(void) {
 }
 
 static int audio_alsa_get_desired_buffered(void) {
-    return 1100;
+    return AUDIO_FRAMES_AT_OUTPUT_RATE(1100);
 }
 
 static void audio_alsa_play(const uint8_t* buff, size_t len) {
@@ -147,10 +147,11 @@ static void audio_alsa_play(const uint8_t* buff, size_t len) {
 		printf("XRUN.\n");
 		snd_pcm_prepare(pcm_handle);
         // Add some silence to avoid another XRUN
-        char buf[1100 * 4 + len];
-        memset(buf, 0, 1100 * 4);
-        memcpy(buf + 1100 * 4, buff, len);
-		if ((pcm = snd_pcm_writei(pcm_handle, buf, 1100 + frames)) < 0) {
+        int silence = AUDIO_FRAMES_AT_OUTPUT_RATE(1100);
+        char buf[silence * 4 + len];
+        memset(buf, 0, silence * 4);
+        memcpy(buf + silence * 4, buff, len);
+		if ((pcm = snd_pcm_writei(pcm_handle, buf, silence + frames)) < 0) {
 			printf("Failed again %d\n", pcm);
 		}
 	} else if (pcm < 0) {
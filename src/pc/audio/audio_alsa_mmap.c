@@ -0,0 +1,250 @@
+#include "../compat.h"
+
+#if (defined(__linux__) || defined(__BSD__)) && !defined(TARGET_WEB)
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <alsa/asoundlib.h>
+
+#include "macros.h"
+#include "audio_api.h"
+
+/*
+    ALSA backend for low latency without a sound server.
+
+    play() only copies into a ring. A thread of our own, at real-time priority
+    when the system allows it, wakes up every period and moves whatever the
+    ring holds straight into the device buffer with snd_pcm_mmap_begin/commit.
+    With a period of a few ms the device buffer stays that short too, instead
+    of the several game frames the blocking writer in audio_alsa.c needs to
+    survive a slow frame. If the ring runs dry the thread pads a period of
+    silence before the device underruns; real xruns are recovered from and
+    reported.
+
+    The device can be picked with the SM64_ALSA_DEVICE environment variable,
+    e.g. hw:0 to bypass dmix.
+*/
+
+#define PCM_DEVICE "default"
+// Interleaved stereo frames between play() and the device thread, must be a power of two
+#define RING_FRAMES 8192
+// 4 ms at 32 kHz
+#define PERIOD_FRAMES AUDIO_FRAMES_AT_OUTPUT_RATE(128)
+#define PERIODS 3
+#define RT_PRIORITY 70
+
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static struct {
+    snd_pcm_t *pcm;
+    snd_pcm_uframes_t period_size;
+    snd_pcm_uframes_t buffer_size;
+    pthread_t thread;
+
+    uint32_t ring[RING_FRAMES];
+    uint32_t ring_head;   // frames written, only advanced by play()
+    uint32_t ring_tail;   // frames sent to the device, only advanced by the device thread
+    uint32_t device_fill; // frames queued in the device after the last commit
+    uint32_t xruns;
+    uint32_t underruns;
+    bool padding;
+} am;
+
+static void audio_alsa_mmap_sleep(void) {
+    struct timespec ts = { 0, 500000 };
+    nanosleep(&ts, NULL);
+}
+
+static void audio_alsa_mmap_xrun(int err) {
+    am.xruns++;
+    fprintf(stderr, "ALSA: xrun %u (%s)\n", am.xruns, snd_strerror(err));
+    if ((err = snd_pcm_recover(am.pcm, err, 1)) < 0) {
+        fprintf(stderr, "ALSA: can't recover: %s\n", snd_strerror(err));
+        audio_alsa_mmap_sleep();
+    }
+}
+
+// Copies up to max_frames from the ring into the device, or silence if pad is set and the ring is empty
+static snd_pcm_sframes_t audio_alsa_mmap_write(snd_pcm_uframes_t max_frames, bool pad) {
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset;
+    snd_pcm_uframes_t frames = max_frames;
+    uint32_t tail = am.ring_tail;
+    uint32_t available = LOAD_ACQUIRE(&am.ring_head) - tail;
+    uint32_t *dest;
+    int err;
+
+    if (available == 0 && !pad) {
+        return 0;
+    }
+    if ((err = snd_pcm_mmap_begin(am.pcm, &areas, &offset, &frames)) < 0) {
+        return err;
+    }
+    // Interleaved stereo S16, so a frame is one uint32_t
+    dest = (uint32_t *)((uint8_t *)areas[0].addr + areas[0].first / 8) + offset;
+
+    if (available == 0) {
+        memset(dest, 0, frames * 4);
+    } else {
+        uint32_t start = tail % RING_FRAMES;
+        uint32_t first;
+
+        frames = MIN(frames, available);
+        first = MIN(frames, RING_FRAMES - start);
+        memcpy(dest, &am.ring[start], first * 4);
+        memcpy(dest + first, &am.ring[0], (frames - first) * 4);
+        STORE_RELEASE(&am.ring_tail, tail + frames);
+    }
+
+    return snd_pcm_mmap_commit(am.pcm, offset, frames);
+}
+
+static void *audio_alsa_mmap_thread(UNUSED void *arg) {
+    for (;;) {
+        snd_pcm_sframes_t avail;
+        snd_pcm_sframes_t written = 0;
+        bool wrote = false;
+        int err;
+
+        if ((err = snd_pcm_wait(am.pcm, 100)) < 0) {
+            audio_alsa_mmap_xrun(err);
+            continue;
+        }
+        if ((avail = snd_pcm_avail_update(am.pcm)) < 0) {
+            audio_alsa_mmap_xrun(avail);
+            continue;
+        }
+
+        while (avail > 0) {
+            // Only pad with silence once the device is about to run dry
+            bool pad = am.buffer_size - avail <= am.period_size
+                       && snd_pcm_state(am.pcm) == SND_PCM_STATE_RUNNING;
+            bool empty = LOAD_ACQUIRE(&am.ring_head) == am.ring_tail;
+            // At most a period of silence, so samples that arrive meanwhile don't wait behind more
+            snd_pcm_uframes_t max_frames = pad ? MIN((snd_pcm_uframes_t)avail, am.period_size)
+                                               : (snd_pcm_uframes_t)avail;
+            if ((written = audio_alsa_mmap_write(max_frames, pad)) <= 0) {
+                break;
+            }
+            if (pad && empty && !am.padding) {
+                fprintf(stderr, "ALSA: underrun %u, padding with silence\n", ++am.underruns);
+            }
+            am.padding = pad && empty;
+            avail -= written;
+            wrote = true;
+        }
+        if (written < 0) {
+            audio_alsa_mmap_xrun(written);
+            continue;
+        }
+        __atomic_store_n(&am.device_fill, (uint32_t)(am.buffer_size - avail), __ATOMIC_RELAXED);
+
+        if (!wrote) {
+            // snd_pcm_wait returns at once while there is room, so don't spin on an empty ring
+            audio_alsa_mmap_sleep();
+        }
+    }
+    return NULL;
+}
+
+static bool audio_alsa_mmap_init(void) {
+    const char *device = getenv("SM64_ALSA_DEVICE");
+    snd_pcm_hw_params_t *hw_params;
+    snd_pcm_sw_params_t *sw_params;
+    unsigned int rate = audio_output_frequency;
+    struct sched_param sched = { .sched_priority = RT_PRIORITY };
+    int err;
+
+    if (device == NULL) {
+        device = PCM_DEVICE;
+    }
+    if ((err = snd_pcm_open(&am.pcm, device, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
+        fprintf(stderr, "ALSA: can't open \"%s\": %s\n", device, snd_strerror(err));
+        return false;
+    }
+
+    snd_pcm_hw_params_alloca(&hw_params);
+    snd_pcm_hw_params_any(am.pcm, hw_params);
+    am.period_size = PERIOD_FRAMES;
+    am.buffer_size = PERIOD_FRAMES * PERIODS;
+    if ((err = snd_pcm_hw_params_set_access(am.pcm, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0
+        || (err = snd_pcm_hw_params_set_format(am.pcm, hw_params, SND_PCM_FORMAT_S16_LE)) < 0
+        || (err = snd_pcm_hw_params_set_channels(am.pcm, hw_params, 2)) < 0
+        || (err = snd_pcm_hw_params_set_rate_near(am.pcm, hw_params, &rate, NULL)) < 0
+        || (err = snd_pcm_hw_params_set_period_size_near(am.pcm, hw_params, &am.period_size, NULL)) < 0
+        || (err = snd_pcm_hw_params_set_buffer_size_near(am.pcm, hw_params, &am.buffer_size)) < 0
+        || (err = snd_pcm_hw_params(am.pcm, hw_params)) < 0) {
+        fprintf(stderr, "ALSA: can't set up mmap playback on \"%s\": %s\n", device, snd_strerror(err));
+        goto fail;
+    }
+    if (rate != audio_output_frequency) {
+        fprintf(stderr, "ALSA: \"%s\" doesn't support %u Hz\n", device, audio_output_frequency);
+        goto fail;
+    }
+    snd_pcm_hw_params_get_period_size(hw_params, &am.period_size, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw_params, &am.buffer_size);
+
+    // Wake up every period, and start as soon as the first one is in
+    snd_pcm_sw_params_alloca(&sw_params);
+    snd_pcm_sw_params_current(am.pcm, sw_params);
+    if ((err = snd_pcm_sw_params_set_avail_min(am.pcm, sw_params, am.period_size)) < 0
+        || (err = snd_pcm_sw_params_set_start_threshold(am.pcm, sw_params, am.period_size)) < 0
+        || (err = snd_pcm_sw_params(am.pcm, sw_params)) < 0) {
+        fprintf(stderr, "ALSA: can't set software parameters: %s\n", snd_strerror(err));
+        goto fail;
+    }
+
+    if (pthread_create(&am.thread, NULL, audio_alsa_mmap_thread, NULL) != 0) {
+        goto fail;
+    }
+    if (pthread_setschedparam(am.thread, SCHED_FIFO, &sched) != 0) {
+        fprintf(stderr, "ALSA: no real-time priority for the audio thread, latency may suffer\n");
+    }
+    fprintf(stderr, "ALSA: mmap playback on \"%s\", %lu frame periods, %lu frame buffer\n", device,
+            (unsigned long)am.period_size, (unsigned long)am.buffer_size);
+    return true;
+
+fail:
+    snd_pcm_close(am.pcm);
+    am.pcm = NULL;
+    return false;
+}
+
+static int audio_alsa_mmap_buffered(void) {
+    return LOAD_ACQUIRE(&am.ring_head) - LOAD_ACQUIRE(&am.ring_tail)
+           + __atomic_load_n(&am.device_fill, __ATOMIC_RELAXED);
+}
+
+static int audio_alsa_mmap_get_desired_buffered(void) {
+    // The device buffer plus enough for the game to hand over its next frame in time
+    return am.buffer_size + AUDIO_FRAMES_AT_OUTPUT_RATE(800);
+}
+
+static void audio_alsa_mmap_play(const uint8_t *buf, size_t len) {
+    uint32_t head = am.ring_head;
+    uint32_t room = RING_FRAMES - (head - LOAD_ACQUIRE(&am.ring_tail));
+    uint32_t frames = MIN(len / 4, room);
+    uint32_t start = head % RING_FRAMES;
+    uint32_t first = MIN(frames, RING_FRAMES - start);
+
+    memcpy(&am.ring[start], buf, first * 4);
+    memcpy(&am.ring[0], buf + first * 4, (frames - first) * 4);
+    STORE_RELEASE(&am.ring_head, head + frames);
+}
+
+struct AudioAPI audio_alsa_mmap = {
+    audio_alsa_mmap_init,
+    audio_alsa_mmap_buffered,
+    audio_alsa_mmap_get_desired_buffered,
+    audio_alsa_mmap_play
+};
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef AUDIO_ALSA_MMAP_H
+#define AUDIO_ALSA_MMAP_H
+
+#include "../compat.h"
+
+#if defined(__linux__) || defined(__BSD__)
+extern struct AudioAPI audio_alsa_mmap;
+#endif
+
+#endif
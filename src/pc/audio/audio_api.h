@@ -12,4 +12,27 @@ struct AudioAPI {
     void (*play)(const uint8_t *buf, size_t len);
 };
 
+// Sample rate the game synthesizes at and every backend opens its device with,
+// set before any backend is initialized
+extern uint32_t audio_output_frequency;
+
+// Converts a frame count at the N64 rate of 32 kHz to the output rate
+#define AUDIO_FRAMES_AT_OUTPUT_RATE(n) ((n) * audio_output_frequency / 32000)
+
+#ifdef VERSION_EU
+#define AUDIO_FRAMES_PER_SECOND 50
+#else
+#define AUDIO_FRAMES_PER_SECOND 60
+#endif
+
+// The synthesis splits an audio frame into updates of at most 160 samples,
+// with room for MAX_UPDATES_PER_FRAME of them at up to 48 kHz
+#define AUDIO_MIN_FREQUENCY 16000
+#define AUDIO_MAX_FREQUENCY 48000
+
+// Audio frames alternate between a few samples more and a few less than the output rate needs,
+// depending on the backend buffer level. At 32 kHz that's 544 and 528 (656 and 640 on EU).
+#define SAMPLES_HIGH_AT(freq) (((freq) / AUDIO_FRAMES_PER_SECOND + 1 + 15) & ~15)
+#define SAMPLES_HIGH_MAX SAMPLES_HIGH_AT(AUDIO_MAX_FREQUENCY)
+
 #endif
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <time.h>
+#endif
+
+#include "audio_api.h"
+#include "audio_capture.h"
+#include "audio_latency.h"
+
+/*
+    Backend that writes the exact stream passed to play() to a file instead
+    of a device, for hashing the output of headless runs and for measuring
+    synthesis speed without a sound server.
+
+    SM64_AUDIO_CAPTURE names the output: a path ending in .wav gets a WAV
+    header, - writes raw samples to stdout for piping, anything else is a raw
+    file of interleaved stereo S16 at the output rate. buffered() reports the
+    fill level of a device draining at the output rate since the first
+    play(). With SM64_AUDIO_CAPTURE_FAST=1 it reports the latency target
+    instead, so the game synthesizes the nominal frame sizes no matter how
+    fast it runs and the stream only depends on what the game did.
+*/
+
+// The WAV header is brought up to date about once a second, so a killed run still leaves a valid file
+#define WAV_UPDATE_INTERVAL AUDIO_FRAMES_PER_SECOND
+
+static struct {
+    FILE *file;
+    bool wav;
+    bool fast;
+    bool started;
+    double start_time;
+    uint64_t frames_written;
+    uint32_t data_bytes;
+    uint32_t plays_since_update;
+} ac;
+
+static double audio_capture_time(void) {
+#ifdef _WIN32
+    LARGE_INTEGER count;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void write_u16(uint8_t *dest, uint16_t v) {
+    dest[0] = v & 0xff;
+    dest[1] = v >> 8;
+}
+
+static void write_u32(uint8_t *dest, uint32_t v) {
+    write_u16(dest, v & 0xffff);
+    write_u16(dest + 2, v >> 16);
+}
+
+static void audio_capture_write_wav_header(void) {
+    uint8_t header[44];
+
+    memcpy(header, "RIFF", 4);
+    write_u32(header + 4, 36 + ac.data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write_u32(header + 16, 16);
+    write_u16(header + 20, 1); // PCM
+    write_u16(header + 22, 2);
+    write_u32(header + 24, audio_output_frequency);
+    write_u32(header + 28, audio_output_frequency * 4);
+    write_u16(header + 32, 4);
+    write_u16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    write_u32(header + 40, ac.data_bytes);
+
+    fseek(ac.file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), ac.file);
+    fseek(ac.file, 0, SEEK_END);
+}
+
+static void audio_capture_close(void) {
+    if (ac.wav) {
+        audio_capture_write_wav_header();
+    }
+    fclose(ac.file);
+    ac.file = NULL;
+}
+
+static bool audio_capture_init(void) {
+    const char *name = getenv("SM64_AUDIO_CAPTURE");
+    const char *fast = getenv("SM64_AUDIO_CAPTURE_FAST");
+    size_t len;
+
+    if (name == NULL || name[0] == '\0') {
+        return false;
+    }
+    len = strlen(name);
+    ac.fast = fast != NULL && strcmp(fast, "0") != 0;
+
+    if (strcmp(name, "-") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        ac.file = stdout;
+        return true;
+    }
+    if ((ac.file = fopen(name, "wb")) == NULL) {
+        perror(name);
+        return false;
+    }
+    ac.wav = len >= 4 && strcmp(name + len - 4, ".wav") == 0;
+    if (ac.wav) {
+        audio_capture_write_wav_header();
+    }
+    atexit(audio_capture_close);
+    fprintf(stderr, "Audio: capturing %s to %s\n", ac.fast ? "unthrottled" : "in real time", name);
+    return true;
+}
+
+static int audio_capture_buffered(void) {
+    double played;
+
+    if (ac.fast) {
+        return audio_latency_target();
+    }
+    if (!ac.started) {
+        return 0;
+    }
+    played = (audio_capture_time() - ac.start_time) * audio_output_frequency;
+    return played < ac.frames_written ? (int)(ac.frames_written - played) : 0;
+}
+
+static int audio_capture_get_desired_buffered(void) {
+    // Two game frames, about what a real device needs
+    return audio_output_frequency / 15;
+}
+
+static void audio_capture_play(const uint8_t *buf, size_t len) {
+    if (!ac.started) {
+        ac.start_time = audio_capture_time();
+        ac.started = true;
+    } else if (!ac.fast && audio_capture_buffered() == 0) {
+        // Like a device that ran dry, pick up from now instead of catching up on the gap
+        ac.start_time = audio_capture_time() - (double)ac.frames_written / audio_output_frequency;
+    }
+
+    fwrite(buf, 1, len, ac.file);
+    ac.frames_written += len / 4;
+    ac.data_bytes += len;
+
+    if (ac.wav && ++ac.plays_since_update >= WAV_UPDATE_INTERVAL) {
+        audio_capture_write_wav_header();
+        ac.plays_since_update = 0;
+    }
+}
+
+struct AudioAPI audio_capture = {
+    audio_capture_init,
+    audio_capture_buffered,
+    audio_capture_get_desired_buffered,
+    audio_capture_play
+};
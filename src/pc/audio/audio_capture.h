@@ -0,0 +1,8 @@
+#ifndef AUDIO_CAPTURE_H
+#define AUDIO_CAPTURE_H
+
+#include "audio_api.h"
+
+extern struct AudioAPI audio_capture;
+
+#endif
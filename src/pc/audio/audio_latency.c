@@ -0,0 +1,111 @@
+#include <stdio.h>
+
+#include "audio_latency.h"
+#include "audio_api.h"
+
+/*
+    Keeps the backend buffer at a target latency without audible jumps.
+
+    The engine only synthesizes frames of samples_low or samples_high samples,
+    16 apart. Rather than switching between the two whenever the buffer
+    crosses the target, the controller works out a fractional frame size from
+    the buffer level (a proportional term to pull it to the target and a slow
+    integral term that absorbs drift between the game and device clocks) and
+    sigma-delta modulates between the two sizes, so on average the output rate
+    follows it to a fraction of a sample.
+*/
+
+// Corrects a latency error over about half a second
+#define LATENCY_GAIN_P (1.0f / 32.0f)
+// Learns a steady clock drift within a few seconds
+#define LATENCY_GAIN_I (1.0f / 4096.0f)
+
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE_RELAXED(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+
+static struct {
+    uint32_t samples_low;
+    uint32_t samples_high;
+    uint32_t target;
+    float nominal;  // output frames per audio frame at the output rate
+    float integral; // sum of past errors in frames
+    float frames;   // frame size the next frames average to
+    float phase;    // sigma-delta accumulator, in frames above samples_low
+
+    struct AudioLatencyStats stats;
+    struct AudioLatencyStats reported;
+    uint32_t submits_since_report;
+    bool started;
+} al;
+
+void audio_latency_init(uint32_t samples_low, uint32_t samples_high, uint32_t target) {
+    al.samples_low = samples_low;
+    al.samples_high = samples_high;
+    al.target = target;
+    al.nominal = (float)audio_output_frequency / AUDIO_FRAMES_PER_SECOND;
+    al.integral = 0.0f;
+    al.frames = al.nominal;
+    al.phase = 0.0f;
+}
+
+uint32_t audio_latency_target(void) {
+    return al.target;
+}
+
+void audio_latency_update(uint32_t buffered) {
+    float error = (float)buffered - (float)al.target;
+    float frames = al.nominal - error * LATENCY_GAIN_P - al.integral * LATENCY_GAIN_I;
+
+    // Only integrate while the frame size can still follow, so the integral doesn't wind up
+    if (frames < al.samples_low) {
+        frames = al.samples_low;
+    } else if (frames > al.samples_high) {
+        frames = al.samples_high;
+    } else {
+        al.integral += error;
+    }
+    al.frames = frames;
+}
+
+uint32_t audio_latency_next_count(void) {
+    float step = al.samples_high - al.samples_low;
+
+    al.phase += al.frames - al.samples_low;
+    if (al.phase >= step) {
+        al.phase -= step;
+        return al.samples_high;
+    }
+    return al.samples_low;
+}
+
+// Called with the backend level right before submitting samples, returns false to drop them
+bool audio_latency_submit(uint32_t buffered) {
+    bool keep = true;
+
+    if (al.target == 0) {
+        // Nothing is buffered, e.g. the null backend
+        return true;
+    }
+    if (buffered == 0 && al.started) {
+        STORE_RELAXED(&al.stats.underruns, al.stats.underruns + 1);
+    } else if (buffered > 2 * al.target + 4 * al.samples_high) {
+        // Far more than the controller can pull back in reasonable time, e.g. after the game
+        // ran fast without vsync
+        STORE_RELAXED(&al.stats.overruns, al.stats.overruns + 1);
+        keep = false;
+    }
+    al.started = true;
+
+    if (++al.submits_since_report >= AUDIO_FRAMES_PER_SECOND
+        && (al.stats.underruns != al.reported.underruns || al.stats.overruns != al.reported.overruns)) {
+        fprintf(stderr, "audio: %u underruns, %u overruns\n", al.stats.underruns, al.stats.overruns);
+        al.reported = al.stats;
+        al.submits_since_report = 0;
+    }
+    return keep;
+}
+
+void audio_latency_get_stats(struct AudioLatencyStats *stats) {
+    stats->underruns = LOAD_RELAXED(&al.stats.underruns);
+    stats->overruns = LOAD_RELAXED(&al.stats.overruns);
+}
@@ -0,0 +1,19 @@
+#ifndef AUDIO_LATENCY_H
+#define AUDIO_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct AudioLatencyStats {
+    uint32_t underruns; // the backend ran dry before new samples arrived
+    uint32_t overruns;  // samples were dropped because the backend was far past the target
+};
+
+void audio_latency_init(uint32_t samples_low, uint32_t samples_high, uint32_t target);
+uint32_t audio_latency_target(void);
+void audio_latency_update(uint32_t buffered);
+uint32_t audio_latency_next_count(void);
+bool audio_latency_submit(uint32_t buffered);
+void audio_latency_get_stats(struct AudioLatencyStats *stats);
+
+#endif
@@ -77,14 +77,14 @@ static bool audio_pulse_init(void) {
     // Create stream
     pa_sample_spec ss;
     ss.format = PA_SAMPLE_S16LE;
-    ss.rate = 32000;
+    ss.rate = audio_output_frequency;
     ss.channels = 2;
     
     pa_buffer_attr attr;
-    attr.maxlength = (1600 + 544 + 528 + 1600) * 4;
-    attr.tlength = (528*2 + 544) * 4;
-    attr.prebuf = 1500 * 4;
-    attr.minreq = 161 * 4;
+    attr.maxlength = AUDIO_FRAMES_AT_OUTPUT_RATE(1600 + 544 + 528 + 1600) * 4;
+    attr.tlength = AUDIO_FRAMES_AT_OUTPUT_RATE(528*2 + 544) * 4;
+    attr.prebuf = AUDIO_FRAMES_AT_OUTPUT_RATE(1500) * 4;
+    attr.minreq = AUDIO_FRAMES_AT_OUTPUT_RATE(161) * 4;
     attr.fragsize = (uint32_t)-1;
     
     pas.stream = pa_stream_new(pas.context, "mario", &ss, NULL);
@@ -171,7 +171,7 @@ static int audio_pulse_buffered(void) {
 }
 
 static int audio_pulse_get_desired_buffered(void) {
-    return 1100;
+    return AUDIO_FRAMES_AT_OUTPUT_RATE(1100);
 }
 
 static void audio_pulse_play(const uint8_t *buf, size_t len) {
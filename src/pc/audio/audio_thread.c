@@ -0,0 +1,184 @@
+#include "audio_thread.h"
+
+#ifdef AUDIO_THREAD
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "macros.h"
+#include "audio_api.h"
+#include "audio_latency.h"
+
+/*
+    Runs the audio engine on its own thread so that slow game or render frames
+    no longer starve the output device.
+
+    The synthesis thread owns all sound state while it is running. Sound calls
+    made by the game are queued in a single-producer/single-consumer command
+    queue and replayed in order before the next buffer is synthesized. The few
+    calls that return sound state wait for the queue to drain first.
+    Synthesized frames go through a second SPSC ring to the output thread,
+    which feeds the backend whenever it drops below its desired fill level.
+*/
+
+// Interleaved stereo frames between synthesis and output, must be a power of two
+#define AUDIO_RING_FRAMES 4096
+#define AUDIO_COMMAND_QUEUE_SIZE 1024
+#define AUDIO_MAX_CHUNK 1024
+
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+struct AudioThreadCommand {
+    AudioThreadCommandFunc func;
+    uintptr_t args[4];
+};
+
+static struct {
+    struct AudioAPI *api;
+    void (*synthesize)(int16_t *samples, uint32_t num_samples);
+    uint32_t samples_high;
+    pthread_t synth_thread;
+    pthread_t output_thread;
+    bool running;
+
+    uint32_t ring[AUDIO_RING_FRAMES];
+    uint32_t ring_head; // frames written, only advanced by the synthesis thread
+    uint32_t ring_tail; // frames played, only advanced by the output thread
+
+    struct AudioThreadCommand commands[AUDIO_COMMAND_QUEUE_SIZE];
+    uint32_t command_head; // only advanced by the game thread
+    uint32_t command_tail; // only advanced by the synthesis thread
+} at;
+
+static void audio_thread_sleep(void) {
+    struct timespec ts = { 0, 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+static void audio_thread_run_commands(void) {
+    uint32_t head = LOAD_ACQUIRE(&at.command_head);
+    uint32_t tail = at.command_tail;
+
+    while (tail != head) {
+        struct AudioThreadCommand *cmd = &at.commands[tail % AUDIO_COMMAND_QUEUE_SIZE];
+        cmd->func(cmd->args);
+        STORE_RELEASE(&at.command_tail, ++tail);
+    }
+}
+
+static void *audio_synth_thread(UNUSED void *arg) {
+    int16_t samples[AUDIO_MAX_CHUNK * 2];
+
+    for (;;) {
+        audio_thread_run_commands();
+
+        // The output thread keeps the backend at the target, so chunk sizes only need to
+        // average out to the output rate for the sequencer to keep its original tempo
+        uint32_t num_samples = audio_latency_next_count();
+        uint32_t head = at.ring_head;
+        uint32_t filled = head - LOAD_ACQUIRE(&at.ring_tail);
+        if (filled + num_samples > 2 * at.samples_high) {
+            audio_thread_sleep();
+            continue;
+        }
+
+        at.synthesize(samples, num_samples);
+
+        uint32_t start = head % AUDIO_RING_FRAMES;
+        uint32_t first = MIN(num_samples, AUDIO_RING_FRAMES - start);
+        memcpy(&at.ring[start], samples, first * 4);
+        memcpy(&at.ring[0], samples + first * 2, (num_samples - first) * 4);
+        STORE_RELEASE(&at.ring_head, head + num_samples);
+    }
+    return NULL;
+}
+
+static void *audio_output_thread(UNUSED void *arg) {
+    uint32_t frames[AUDIO_MAX_CHUNK * 2];
+
+    for (;;) {
+        uint32_t tail = at.ring_tail;
+        uint32_t available = LOAD_ACQUIRE(&at.ring_head) - tail;
+        int buffered = at.api->buffered();
+        if (available == 0 || buffered >= (int)audio_latency_target()) {
+            audio_thread_sleep();
+            continue;
+        }
+
+        uint32_t num_frames = MIN(available, 2 * at.samples_high);
+        uint32_t start = tail % AUDIO_RING_FRAMES;
+        uint32_t first = MIN(num_frames, AUDIO_RING_FRAMES - start);
+        memcpy(frames, &at.ring[start], first * 4);
+        memcpy(frames + first, &at.ring[0], (num_frames - first) * 4);
+        STORE_RELEASE(&at.ring_tail, tail + num_frames);
+
+        if (audio_latency_submit(buffered)) {
+            at.api->play((const uint8_t *)frames, num_frames * 4);
+        }
+    }
+    return NULL;
+}
+
+bool audio_thread_start(struct AudioAPI *api, void (*synthesize)(int16_t *samples, uint32_t num_samples),
+                        uint32_t samples_high) {
+    if (samples_high > AUDIO_MAX_CHUNK) {
+        return false;
+    }
+    at.api = api;
+    at.synthesize = synthesize;
+    at.samples_high = samples_high;
+
+    if (pthread_create(&at.output_thread, NULL, audio_output_thread, NULL) != 0) {
+        return false;
+    }
+    if (pthread_create(&at.synth_thread, NULL, audio_synth_thread, NULL) != 0) {
+        // Nothing will ever be written to the ring, so the output thread stays idle
+        return false;
+    }
+    at.running = true;
+    return true;
+}
+
+bool audio_thread_defer(AudioThreadCommandFunc func, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2,
+                        uintptr_t arg3) {
+    if (!at.running || pthread_equal(pthread_self(), at.synth_thread)) {
+        return false;
+    }
+
+    uint32_t head = at.command_head;
+    while (head - LOAD_ACQUIRE(&at.command_tail) >= AUDIO_COMMAND_QUEUE_SIZE) {
+        audio_thread_sleep();
+    }
+
+    struct AudioThreadCommand *cmd = &at.commands[head % AUDIO_COMMAND_QUEUE_SIZE];
+    cmd->func = func;
+    cmd->args[0] = arg0;
+    cmd->args[1] = arg1;
+    cmd->args[2] = arg2;
+    cmd->args[3] = arg3;
+    STORE_RELEASE(&at.command_head, head + 1);
+    return true;
+}
+
+/**
+ * Wait until the synthesis thread has run every command queued so far. The game thread is
+ * the only one queueing commands, so until it queues another one it can then read the sound
+ * state they change. Returns false if there is no thread to wait for.
+ */
+bool audio_thread_sync(void) {
+    if (!at.running || pthread_equal(pthread_self(), at.synth_thread)) {
+        return false;
+    }
+
+    uint32_t head = at.command_head;
+    while (LOAD_ACQUIRE(&at.command_tail) != head) {
+        audio_thread_sleep();
+    }
+    return true;
+}
+
+#endif
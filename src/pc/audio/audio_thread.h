@@ -0,0 +1,25 @@
+#ifndef AUDIO_THREAD_H
+#define AUDIO_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../compat.h"
+
+#if (defined(__linux__) || defined(__BSD__)) && !defined(TARGET_WEB)
+#define AUDIO_THREAD 1
+#endif
+
+struct AudioAPI;
+
+typedef void (*AudioThreadCommandFunc)(uintptr_t *args);
+
+#ifdef AUDIO_THREAD
+bool audio_thread_start(struct AudioAPI *api, void (*synthesize)(int16_t *samples, uint32_t num_samples),
+                        uint32_t samples_high);
+bool audio_thread_defer(AudioThreadCommandFunc func, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2,
+                        uintptr_t arg3);
+bool audio_thread_sync(void);
+#endif
+
+#endif
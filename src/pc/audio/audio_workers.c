@@ -0,0 +1,99 @@
+#include "audio_workers.h"
+
+#ifdef AUDIO_WORKERS
+
+#include <pthread.h>
+
+/*
+    A small pool of helper threads for the audio engine.
+
+    audio_workers_run calls func(index, arg) once for every index below
+    audio_workers_count(): index 0 on the calling thread and the others on
+    the helpers, and returns when all of them are done. Only one thread,
+    the one doing synthesis, may hand out work at a time.
+*/
+
+static struct {
+    pthread_t threads[AUDIO_MAX_WORKERS];
+    uint32_t count; // including the calling thread
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    AudioWorkerFunc func;
+    void *arg;
+    uint32_t generation; // bumped for every batch of work
+    uint32_t pending;    // helpers still busy with the current batch
+} aw = { .lock = PTHREAD_MUTEX_INITIALIZER,
+         .work_cond = PTHREAD_COND_INITIALIZER,
+         .done_cond = PTHREAD_COND_INITIALIZER };
+
+static void *audio_worker_thread(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    uint32_t generation = 0;
+
+    pthread_mutex_lock(&aw.lock);
+    for (;;) {
+        while (aw.generation == generation) {
+            pthread_cond_wait(&aw.work_cond, &aw.lock);
+        }
+        generation = aw.generation;
+        AudioWorkerFunc func = aw.func;
+        void *func_arg = aw.arg;
+        pthread_mutex_unlock(&aw.lock);
+
+        func(index, func_arg);
+
+        pthread_mutex_lock(&aw.lock);
+        if (--aw.pending == 0) {
+            pthread_cond_signal(&aw.done_cond);
+        }
+    }
+    return NULL;
+}
+
+bool audio_workers_start(uint32_t num_workers) {
+    if (aw.count != 0) {
+        return false;
+    }
+    if (num_workers > AUDIO_MAX_WORKERS) {
+        num_workers = AUDIO_MAX_WORKERS;
+    }
+
+    aw.count = 1;
+    while (aw.count < num_workers) {
+        if (pthread_create(&aw.threads[aw.count], NULL, audio_worker_thread, (void *)(uintptr_t)aw.count) != 0) {
+            break;
+        }
+        aw.count++;
+    }
+    return aw.count > 1;
+}
+
+uint32_t audio_workers_count(void) {
+    return aw.count != 0 ? aw.count : 1;
+}
+
+void audio_workers_run(AudioWorkerFunc func, void *arg) {
+    if (aw.count > 1) {
+        pthread_mutex_lock(&aw.lock);
+        aw.func = func;
+        aw.arg = arg;
+        aw.pending = aw.count - 1;
+        aw.generation++;
+        pthread_cond_broadcast(&aw.work_cond);
+        pthread_mutex_unlock(&aw.lock);
+    }
+
+    func(0, arg);
+
+    if (aw.count > 1) {
+        pthread_mutex_lock(&aw.lock);
+        while (aw.pending != 0) {
+            pthread_cond_wait(&aw.done_cond, &aw.lock);
+        }
+        pthread_mutex_unlock(&aw.lock);
+    }
+}
+
+#endif
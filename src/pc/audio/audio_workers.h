@@ -0,0 +1,24 @@
+#ifndef AUDIO_WORKERS_H
+#define AUDIO_WORKERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_thread.h"
+
+// Helper threads need the same pthread support as the audio thread
+#ifdef AUDIO_THREAD
+#define AUDIO_WORKERS 1
+#endif
+
+#define AUDIO_MAX_WORKERS 8
+
+typedef void (*AudioWorkerFunc)(uint32_t index, void *arg);
+
+#ifdef AUDIO_WORKERS
+bool audio_workers_start(uint32_t num_workers);
+uint32_t audio_workers_count(void);
+void audio_workers_run(AudioWorkerFunc func, void *arg);
+#endif
+
+#endif
@@ -30,6 +30,10 @@ struct ConfigOption {
  *Config options and default values
  */
 bool configFullscreen            = false;
+unsigned int configAudioFrequency = 32000; // Hz, up to 48000
+unsigned int configAudioThreads = 1;       // threads rendering notes, up to 8
+unsigned int configAudioLatency = 0;       // ms, 0 lets the backend decide
+unsigned int configAudioReverb = 0;        // 0 for the N64 reverb, 1 for a smoother one
 // Keyboard mappings (scancode values)
 unsigned int configKeyA          = 0x26;
 unsigned int configKeyB          = 0x33;
@@ -48,6 +52,10 @@ unsigned int configKeyStickRight = 0x20;
 
 static const struct ConfigOption options[] = {
     {.name = "fullscreen",     .type = CONFIG_TYPE_BOOL, .boolValue = &configFullscreen},
+    {.name = "audio_frequency", .type = CONFIG_TYPE_UINT, .uintValue = &configAudioFrequency},
+    {.name = "audio_threads",  .type = CONFIG_TYPE_UINT, .uintValue = &configAudioThreads},
+    {.name = "audio_latency",  .type = CONFIG_TYPE_UINT, .uintValue = &configAudioLatency},
+    {.name = "audio_reverb",   .type = CONFIG_TYPE_UINT, .uintValue = &configAudioReverb},
     {.name = "key_a",          .type = CONFIG_TYPE_UINT, .uintValue = &configKeyA},
     {.name = "key_b",          .type = CONFIG_TYPE_UINT, .uintValue = &configKeyB},
     {.name = "key_start",      .type = CONFIG_TYPE_UINT, .uintValue = &configKeyStart},
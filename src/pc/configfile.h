@@ -2,6 +2,10 @@
 #define CONFIGFILE_H
 
 extern bool         configFullscreen;
+extern unsigned int configAudioFrequency;
+extern unsigned int configAudioThreads;
+extern unsigned int configAudioLatency;
+extern unsigned int configAudioReverb;
 extern unsigned int configKeyA;
 extern unsigned int configKeyB;
 extern unsigned int configKeyStart;
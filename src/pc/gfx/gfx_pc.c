@@ -38,6 +38,13 @@
 #define MAX_LIGHTS 2
 #define MAX_VERTICES 64
 
+// Small textures drawn with texture rectangles (font glyphs, HUD icons) are packed into one atlas
+// texture so consecutive rectangles can share a draw call
+#define TEXTURE_ATLAS_SIZE 512
+#define TEXTURE_ATLAS_MAX_DIM 32
+#define TEXTURE_ATLAS_PADDING 2
+#define TEXTURE_ATLAS_HASHMAP_SIZE 1024
+
 struct RGBA {
     uint8_t r, g, b, a;
 };
@@ -142,6 +149,37 @@ static struct RenderingState {
     struct TextureHashmapNode *textures[2];
 } rendering_state;
 
+struct TextureAtlasEntry {
+    const uint8_t *texture_addr;
+    uint8_t fmt, siz;
+    bool used;
+    bool rejected; // too big for the atlas, always import it as a separate texture
+    uint16_t x, y; // position of the texture's first texel in the atlas
+    uint16_t width, height;
+};
+
+static struct {
+    struct TextureHashmapNode node; // stands in for the atlas in rendering_state.textures[0]
+    struct TextureAtlasEntry hashmap[TEXTURE_ATLAS_HASHMAP_SIZE];
+    uint32_t num_entries;
+    uint16_t shelf_x, shelf_y, shelf_height;
+    bool initialized;
+    bool dirty; // pixels changed since the last upload
+    bool full;
+    struct TextureAtlasEntry *current;
+    struct TextureAtlasEntry *capture; // import_texture_data writes here instead of uploading
+    uint8_t pixels[TEXTURE_ATLAS_SIZE * TEXTURE_ATLAS_SIZE * 4];
+} gfx_texture_atlas;
+
+// The texture rectangle being drawn, and how its texture coordinates fold back into one period
+// of the texture so that wrapped or mirrored glyphs can be drawn from the atlas
+static struct {
+    bool active;
+    bool fits_atlas;
+    int period_s, period_t;
+    bool mirror_s, mirror_t;
+} texture_rectangle;
+
 struct GfxDimensions gfx_current_dimensions;
 
 static bool dropped_frame;
@@ -162,6 +200,11 @@ static unsigned long get_time(void) {
 
 static void gfx_flush(void) {
     if (buf_vbo_len > 0) {
+        if (gfx_texture_atlas.dirty && rendering_state.textures[0] == &gfx_texture_atlas.node) {
+            gfx_rapi->select_texture(0, gfx_texture_atlas.node.texture_id);
+            gfx_rapi->upload_texture(gfx_texture_atlas.pixels, TEXTURE_ATLAS_SIZE, TEXTURE_ATLAS_SIZE);
+            gfx_texture_atlas.dirty = false;
+        }
         int num = buf_vbo_num_tris;
         unsigned long t0 = get_time();
         gfx_rapi->draw_triangles(buf_vbo, buf_vbo_len, buf_vbo_num_tris);
@@ -283,6 +326,57 @@ static bool gfx_texture_cache_lookup(int tile, struct TextureHashmapNode **n, co
     return false;
 }
 
+static bool gfx_texture_atlas_store(struct TextureAtlasEntry *entry, const uint8_t *rgba32_buf, int width, int height) {
+    int padded_width = width + 2 * TEXTURE_ATLAS_PADDING;
+    int padded_height = height + 2 * TEXTURE_ATLAS_PADDING;
+    
+    if (width > TEXTURE_ATLAS_MAX_DIM || height > TEXTURE_ATLAS_MAX_DIM) {
+        return false;
+    }
+    if (gfx_texture_atlas.shelf_x + padded_width > TEXTURE_ATLAS_SIZE) {
+        gfx_texture_atlas.shelf_x = 0;
+        gfx_texture_atlas.shelf_y += gfx_texture_atlas.shelf_height;
+        gfx_texture_atlas.shelf_height = 0;
+    }
+    if (gfx_texture_atlas.shelf_y + padded_height > TEXTURE_ATLAS_SIZE) {
+        gfx_texture_atlas.full = true;
+        return false;
+    }
+    
+    // Replicate the edge texels into the padding, so filtering at the edges behaves like clamping
+    for (int y = 0; y < padded_height; y++) {
+        int src_y = y - TEXTURE_ATLAS_PADDING;
+        src_y = src_y < 0 ? 0 : (src_y >= height ? height - 1 : src_y);
+        uint8_t *dst = &gfx_texture_atlas.pixels[((gfx_texture_atlas.shelf_y + y) * TEXTURE_ATLAS_SIZE + gfx_texture_atlas.shelf_x) * 4];
+        for (int x = 0; x < padded_width; x++) {
+            int src_x = x - TEXTURE_ATLAS_PADDING;
+            src_x = src_x < 0 ? 0 : (src_x >= width ? width - 1 : src_x);
+            memcpy(dst + 4 * x, rgba32_buf + 4 * (src_y * width + src_x), 4);
+        }
+    }
+    
+    entry->x = gfx_texture_atlas.shelf_x + TEXTURE_ATLAS_PADDING;
+    entry->y = gfx_texture_atlas.shelf_y + TEXTURE_ATLAS_PADDING;
+    entry->width = width;
+    entry->height = height;
+    gfx_texture_atlas.shelf_x += padded_width;
+    if (padded_height > gfx_texture_atlas.shelf_height) {
+        gfx_texture_atlas.shelf_height = padded_height;
+    }
+    gfx_texture_atlas.dirty = true;
+    return true;
+}
+
+static void gfx_upload_texture(const uint8_t *rgba32_buf, int width, int height) {
+    if (gfx_texture_atlas.capture != NULL) {
+        if (!gfx_texture_atlas_store(gfx_texture_atlas.capture, rgba32_buf, width, height)) {
+            gfx_texture_atlas.capture->rejected = true;
+        }
+        return;
+    }
+    gfx_rapi->upload_texture(rgba32_buf, width, height);
+}
+
 static void import_texture_rgba16(int tile) {
     uint8_t rgba32_buf[8192];
     
@@ -301,13 +395,13 @@ static void import_texture_rgba16(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_rgba32(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = (rdp.loaded_texture[tile].size_bytes / 2) / rdp.texture_tile.line_size_bytes;
-    gfx_rapi->upload_texture(rdp.loaded_texture[tile].addr, width, height);
+    gfx_upload_texture(rdp.loaded_texture[tile].addr, width, height);
 }
 
 static void import_texture_ia4(int tile) {
@@ -330,7 +424,7 @@ static void import_texture_ia4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ia8(int tile) {
@@ -351,7 +445,7 @@ static void import_texture_ia8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ia16(int tile) {
@@ -372,7 +466,7 @@ static void import_texture_ia16(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_i4(int tile) {
@@ -394,7 +488,7 @@ static void import_texture_i4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
 
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_i8(int tile) {
@@ -414,7 +508,7 @@ static void import_texture_i8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
 
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 
@@ -438,7 +532,7 @@ static void import_texture_ci4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ci8(int tile) {
@@ -460,18 +554,13 @@ static void import_texture_ci8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
-static void import_texture(int tile) {
+static void import_texture_data(int tile) {
     uint8_t fmt = rdp.texture_tile.fmt;
     uint8_t siz = rdp.texture_tile.siz;
     
-    if (gfx_texture_cache_lookup(tile, &rendering_state.textures[tile], rdp.loaded_texture[tile].addr, fmt, siz)) {
-        return;
-    }
-    
-    int t0 = get_time();
     if (fmt == G_IM_FMT_RGBA) {
         if (siz == G_IM_SIZ_16b) {
             import_texture_rgba16(tile);
@@ -509,10 +598,122 @@ static void import_texture(int tile) {
     } else {
         abort();
     }
+}
+
+static void import_texture(int tile) {
+    uint8_t fmt = rdp.texture_tile.fmt;
+    uint8_t siz = rdp.texture_tile.siz;
+    
+    if (gfx_texture_cache_lookup(tile, &rendering_state.textures[tile], rdp.loaded_texture[tile].addr, fmt, siz)) {
+        return;
+    }
+    
+    int t0 = get_time();
+    import_texture_data(tile);
     int t1 = get_time();
     //printf("Time diff: %d\n", t1 - t0);
 }
 
+static void gfx_texture_atlas_reset(void) {
+    memset(gfx_texture_atlas.hashmap, 0, sizeof(gfx_texture_atlas.hashmap));
+    gfx_texture_atlas.num_entries = 0;
+    gfx_texture_atlas.shelf_x = 0;
+    gfx_texture_atlas.shelf_y = 0;
+    gfx_texture_atlas.shelf_height = 0;
+    gfx_texture_atlas.full = false;
+    gfx_texture_atlas.current = NULL;
+}
+
+static struct TextureAtlasEntry *gfx_texture_atlas_lookup(const uint8_t *addr, uint8_t fmt, uint8_t siz) {
+    size_t hash = ((uintptr_t)addr >> 3) & (TEXTURE_ATLAS_HASHMAP_SIZE - 1);
+    for (;;) {
+        struct TextureAtlasEntry *entry = &gfx_texture_atlas.hashmap[hash];
+        if (!entry->used || (entry->texture_addr == addr && entry->fmt == fmt && entry->siz == siz)) {
+            return entry;
+        }
+        hash = (hash + 1) & (TEXTURE_ATLAS_HASHMAP_SIZE - 1);
+    }
+}
+
+// Make the texture loaded in tile 0 available from the atlas, and bind the atlas.
+// Returns false if the texture has to be imported on its own instead.
+static bool gfx_texture_atlas_select(void) {
+    if (!texture_rectangle.active || !texture_rectangle.fits_atlas) {
+        return false;
+    }
+    if (!rdp.textures_changed[0] && rendering_state.textures[0] == &gfx_texture_atlas.node && gfx_texture_atlas.current != NULL) {
+        return true;
+    }
+    
+    if (!gfx_texture_atlas.initialized) {
+        gfx_texture_atlas.node.texture_id = gfx_rapi->new_texture();
+        gfx_texture_atlas.initialized = true;
+    }
+    
+    const uint8_t *addr = rdp.loaded_texture[0].addr;
+    struct TextureAtlasEntry *entry = gfx_texture_atlas_lookup(addr, rdp.texture_tile.fmt, rdp.texture_tile.siz);
+    if (!entry->used) {
+        if (gfx_texture_atlas.num_entries >= TEXTURE_ATLAS_HASHMAP_SIZE / 2) {
+            // Keep the hashmap sparse. Start over, the same way the texture cache does when full.
+            gfx_flush();
+            gfx_texture_atlas_reset();
+            entry = gfx_texture_atlas_lookup(addr, rdp.texture_tile.fmt, rdp.texture_tile.siz);
+        }
+        entry->used = true;
+        entry->texture_addr = addr;
+        entry->fmt = rdp.texture_tile.fmt;
+        entry->siz = rdp.texture_tile.siz;
+        entry->rejected = false;
+        gfx_texture_atlas.num_entries++;
+        
+        gfx_texture_atlas.capture = entry;
+        import_texture_data(0);
+        gfx_texture_atlas.capture = NULL;
+        
+        if (gfx_texture_atlas.full) {
+            // Out of space rather than the texture being too big, start over and try again
+            gfx_flush();
+            gfx_texture_atlas_reset();
+            return gfx_texture_atlas_select();
+        }
+    }
+    if (entry->rejected) {
+        return false;
+    }
+    
+    if (rendering_state.textures[0] != &gfx_texture_atlas.node) {
+        gfx_flush();
+        gfx_rapi->select_texture(0, gfx_texture_atlas.node.texture_id);
+        rendering_state.textures[0] = &gfx_texture_atlas.node;
+    }
+    gfx_texture_atlas.current = entry;
+    rdp.textures_changed[0] = false;
+    return true;
+}
+
+// Fold a texture rectangle's coordinate range into a single period of the texture, the way the
+// sampler's wrap mode would.
+static bool gfx_texture_rectangle_fold(float min, float max, uint32_t size, uint8_t cm, int *period, bool *mirror) {
+    int k = 0;
+    if (!(cm & G_TX_CLAMP)) {
+        k = (int)floorf(min / size);
+    }
+    if (min - k * (float)size < -1.0f || max - k * (float)size > size + 1.0f) {
+        return false;
+    }
+    *period = k;
+    *mirror = !(cm & G_TX_CLAMP) && (cm & G_TX_MIRROR) && (k & 1);
+    return true;
+}
+
+static float gfx_texture_atlas_map_coord(float c, uint32_t size, int period, bool mirror, uint16_t atlas_pos, uint16_t atlas_size) {
+    c -= period * (float)size;
+    if (mirror) {
+        c = size - c;
+    }
+    return (atlas_pos + c * atlas_size / size) / TEXTURE_ATLAS_SIZE;
+}
+
 static void gfx_normalize_vector(float v[3]) {
     float s = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
     v[0] /= s;
@@ -818,20 +1019,27 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
     bool used_textures[2];
     gfx_rapi->shader_get_info(prg, &num_inputs, used_textures);
     
+    bool use_atlas = false;
     for (int i = 0; i < 2; i++) {
         if (used_textures[i]) {
-            if (rdp.textures_changed[i]) {
+            if (i == 0 && !used_textures[1]) {
+                use_atlas = gfx_texture_atlas_select();
+            }
+            if (!use_atlas && (rdp.textures_changed[i] || rendering_state.textures[i] == &gfx_texture_atlas.node)) {
                 gfx_flush();
                 import_texture(i);
                 rdp.textures_changed[i] = false;
             }
             bool linear_filter = (rdp.other_mode_h & (3U << G_MDSFT_TEXTFILT)) != G_TF_POINT;
-            if (linear_filter != rendering_state.textures[i]->linear_filter || rdp.texture_tile.cms != rendering_state.textures[i]->cms || rdp.texture_tile.cmt != rendering_state.textures[i]->cmt) {
+            // Wrapping is already resolved when mapping into the atlas
+            uint8_t cms = use_atlas ? G_TX_CLAMP : rdp.texture_tile.cms;
+            uint8_t cmt = use_atlas ? G_TX_CLAMP : rdp.texture_tile.cmt;
+            if (linear_filter != rendering_state.textures[i]->linear_filter || cms != rendering_state.textures[i]->cms || cmt != rendering_state.textures[i]->cmt) {
                 gfx_flush();
-                gfx_rapi->set_sampler_parameters(i, linear_filter, rdp.texture_tile.cms, rdp.texture_tile.cmt);
+                gfx_rapi->set_sampler_parameters(i, linear_filter, cms, cmt);
                 rendering_state.textures[i]->linear_filter = linear_filter;
-                rendering_state.textures[i]->cms = rdp.texture_tile.cms;
-                rendering_state.textures[i]->cmt = rdp.texture_tile.cmt;
+                rendering_state.textures[i]->cms = cms;
+                rendering_state.textures[i]->cmt = cmt;
             }
         }
     }
@@ -860,8 +1068,14 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
                 u += 0.5f;
                 v += 0.5f;
             }
-            buf_vbo[buf_vbo_len++] = u / tex_width;
-            buf_vbo[buf_vbo_len++] = v / tex_height;
+            if (use_atlas) {
+                struct TextureAtlasEntry *entry = gfx_texture_atlas.current;
+                buf_vbo[buf_vbo_len++] = gfx_texture_atlas_map_coord(u, tex_width, texture_rectangle.period_s, texture_rectangle.mirror_s, entry->x, entry->width);
+                buf_vbo[buf_vbo_len++] = gfx_texture_atlas_map_coord(v, tex_height, texture_rectangle.period_t, texture_rectangle.mirror_t, entry->y, entry->height);
+            } else {
+                buf_vbo[buf_vbo_len++] = u / tex_width;
+                buf_vbo[buf_vbo_len++] = v / tex_height;
+            }
         }
         
         if (use_fog) {
@@ -1305,7 +1519,19 @@ static void gfx_dp_texture_rectangle(int32_t ulx, int32_t uly, int32_t lrx, int3
         ur->v = lrt;
     }
     
+    uint32_t tex_width = (rdp.texture_tile.lrs - rdp.texture_tile.uls + 4) / 4;
+    uint32_t tex_height = (rdp.texture_tile.lrt - rdp.texture_tile.ult + 4) / 4;
+    float min_s = (fminf(uls, lrs) - rdp.texture_tile.uls * 8) / 32.0f;
+    float max_s = (fmaxf(uls, lrs) - rdp.texture_tile.uls * 8) / 32.0f;
+    float min_t = (fminf(ult, lrt) - rdp.texture_tile.ult * 8) / 32.0f;
+    float max_t = (fmaxf(ult, lrt) - rdp.texture_tile.ult * 8) / 32.0f;
+    
+    texture_rectangle.active = true;
+    texture_rectangle.fits_atlas = tex_width <= TEXTURE_ATLAS_MAX_DIM && tex_height <= TEXTURE_ATLAS_MAX_DIM
+        && gfx_texture_rectangle_fold(min_s, max_s, tex_width, rdp.texture_tile.cms, &texture_rectangle.period_s, &texture_rectangle.mirror_s)
+        && gfx_texture_rectangle_fold(min_t, max_t, tex_height, rdp.texture_tile.cmt, &texture_rectangle.period_t, &texture_rectangle.mirror_t);
     gfx_draw_rectangle(ulx, uly, lrx, lry);
+    texture_rectangle.active = false;
     rdp.combine_mode = saved_combine_mode;
 }
 
@@ -1,24 +1,38 @@
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ultra64.h>
 
-#ifdef __SSE4_1__
+#include "mixer.h"
+#include "audio/audio_workers.h"
+
+#ifdef AUDIO_WORKERS
+#include <pthread.h>
+// Notes may be synthesized on several threads at once, each with its own DMEM
+#define MIXER_THREAD_LOCAL __thread
+#else
+#define MIXER_THREAD_LOCAL
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
 #include <immintrin.h>
-#define HAS_SSE41 1
+// x86 builds carry SSE4.1 and AVX2 variants of the heavy kernels and pick one at runtime
+#define MIXER_DISPATCH 1
 #define HAS_NEON 0
 #elif __ARM_NEON
 #include <arm_neon.h>
-#define HAS_SSE41 0
+#define MIXER_DISPATCH 0
 #define HAS_NEON 1
 #else
-#define HAS_SSE41 0
+#define MIXER_DISPATCH 0
 #define HAS_NEON 0
 #endif
 
 #pragma GCC optimize ("unroll-loops")
 
-#if HAS_SSE41
+#if defined(__x86_64__) || defined(__i386__)
 #define LOADLH(l, h) _mm_castpd_si128(_mm_loadh_pd(_mm_load_sd((const double *)(l)), (const double *)(h)))
 #endif
 
@@ -26,7 +40,25 @@
 #define ROUND_UP_16(v) (((v) + 15) & ~15)
 #define ROUND_UP_8(v) (((v) + 7) & ~7)
 
-static struct {
+// The high quality reverb damps the feedback of its lines above this frequency
+#define REVERB_FDN_DAMPING_HZ 6000.0f
+// Added and taken away again so that decaying lines flush to zero instead of going denormal
+#define REVERB_FDN_DENORMAL_GUARD 1e-18f
+
+// Decoded PCM of instrument samples is kept around, up to this many bytes in total.
+// Samples longer than ADPCM_CACHE_MAX_FRAMES (about two seconds) are always decoded as they play.
+#define ADPCM_CACHE_BUDGET (8 * 1024 * 1024)
+#define ADPCM_CACHE_MAX_FRAMES 4096
+#define ADPCM_CACHE_ENTRIES 256
+#define ADPCM_CACHE_BUCKETS 128
+
+// Scratch DMEM past the 2512 bytes of the RSP, used while recording and replaying bus mixes
+#define MIXER_SCRATCH_SIZE 0x200
+#define MIXER_SCRATCH_IN 2512
+#define MIXER_SCRATCH_OUT (MIXER_SCRATCH_IN + MIXER_SCRATCH_SIZE)
+#define MIXER_DMEM_SIZE (MIXER_SCRATCH_OUT + MIXER_SCRATCH_SIZE)
+
+static MIXER_THREAD_LOCAL struct {
     uint16_t in;
     uint16_t out;
     uint16_t nbytes;
@@ -47,8 +79,8 @@ static struct {
 
     int16_t adpcm_table[8][2][8];
     union {
-        int16_t as_s16[2512 / sizeof(int16_t)];
-        uint8_t as_u8[2512];
+        int16_t as_s16[MIXER_DMEM_SIZE / sizeof(int16_t)];
+        uint8_t as_u8[MIXER_DMEM_SIZE];
     } buf;
 } rspa;
 
@@ -105,6 +137,69 @@ static inline int32_t clamp32(int64_t v) {
     return (int32_t)v;
 }
 
+struct MixerKernels {
+    void (*adpcm_dec)(uint8_t flags, ADPCM_STATE state, const uint8_t *source_addr, int16_t *out, int nbytes);
+    void (*resample)(uint8_t flags, uint16_t pitch, RESAMPLE_STATE state);
+    void (*env_mixer)(uint8_t flags, ENVMIX_STATE state);
+    void (*mix)(int16_t gain, uint16_t in_addr, uint16_t out_addr);
+};
+
+#if MIXER_DISPATCH
+#define MIXER_TARGET __attribute__((target("avx2")))
+#define MIXER_KERNEL(name) name##_avx2
+#define HAS_AVX2 1
+#define HAS_SSE41 1
+#include "mixer/kernels.inc.c"
+#undef MIXER_TARGET
+#undef MIXER_KERNEL
+#undef HAS_AVX2
+#undef HAS_SSE41
+
+#define MIXER_TARGET __attribute__((target("sse4.1")))
+#define MIXER_KERNEL(name) name##_sse41
+#define HAS_AVX2 0
+#define HAS_SSE41 1
+#include "mixer/kernels.inc.c"
+#undef MIXER_TARGET
+#undef MIXER_KERNEL
+#undef HAS_AVX2
+#undef HAS_SSE41
+#endif
+
+// Whatever the compiler flags allow, used when the CPU has none of the above
+#define MIXER_TARGET
+#define MIXER_KERNEL(name) name##_generic
+#define HAS_AVX2 0
+#ifdef __SSE4_1__
+#define HAS_SSE41 1
+#else
+#define HAS_SSE41 0
+#endif
+#include "mixer/kernels.inc.c"
+#undef MIXER_TARGET
+#undef MIXER_KERNEL
+#undef HAS_AVX2
+#undef HAS_SSE41
+
+static const struct MixerKernels *sMixerKernels;
+
+static const struct MixerKernels *get_mixer_kernels(void) {
+    if (sMixerKernels == NULL) {
+#if MIXER_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            sMixerKernels = &mixer_kernels_avx2;
+        } else if (__builtin_cpu_supports("sse4.1")) {
+            sMixerKernels = &mixer_kernels_sse41;
+        } else
+#endif
+        {
+            sMixerKernels = &mixer_kernels_generic;
+        }
+    }
+    return sMixerKernels;
+}
+
 void aClearBufferImpl(uint16_t addr, int nbytes) {
     nbytes = ROUND_UP_16(nbytes);
     memset(rspa.buf.as_u8 + addr, 0, nbytes);
@@ -156,10 +251,14 @@ void aSetVolumeImpl(uint8_t flags, int16_t v, int16_t t, int16_t r) {
 }
 
 void aInterleaveImpl(uint16_t left, uint16_t right) {
+    aInterleaveSaveImpl(rspa.buf.as_s16 + rspa.out / sizeof(int16_t), left, right);
+}
+
+void aInterleaveSaveImpl(int16_t *dest_addr, uint16_t left, uint16_t right) {
     int count = ROUND_UP_16(rspa.nbytes) / sizeof(int16_t) / 8;
     int16_t *l = rspa.buf.as_s16 + left / sizeof(int16_t);
     int16_t *r = rspa.buf.as_s16 + right / sizeof(int16_t);
-    int16_t *d = rspa.buf.as_s16 + rspa.out / sizeof(int16_t);
+    int16_t *d = dest_addr;
     while (count > 0) {
         int16_t l0 = *l++;
         int16_t l1 = *l++;
@@ -207,665 +306,514 @@ void aSetLoopImpl(ADPCM_STATE *adpcm_loop_state) {
 }
 
 void aADPCMdecImpl(uint8_t flags, ADPCM_STATE state) {
-#if HAS_SSE41
-    const __m128i tblrev = _mm_setr_epi8(12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1, -1, -1);
-    const __m128i pos0 = _mm_set_epi8(3, -1, 3, -1, 2, -1, 2, -1, 1, -1, 1, -1, 0, -1, 0, -1);
-    const __m128i pos1 = _mm_set_epi8(7, -1, 7, -1, 6, -1, 6, -1, 5, -1, 5, -1, 4, -1, 4, -1);
-    const __m128i mult = _mm_set_epi16(0x10, 0x01, 0x10, 0x01, 0x10, 0x01, 0x10, 0x01);
-    const __m128i mask = _mm_set1_epi16((int16_t)0xf000);
-#elif HAS_NEON
-    static const int8_t pos0_data[] = {-1, 0, -1, 0, -1, 1, -1, 1, -1, 2, -1, 2, -1, 3, -1, 3};
-    static const int8_t pos1_data[] = {-1, 4, -1, 4, -1, 5, -1, 5, -1, 6, -1, 6, -1, 7, -1, 7};
-    static const int16_t mult_data[] = {0x01, 0x10, 0x01, 0x10, 0x01, 0x10, 0x01, 0x10};
-    static const int16_t table_prefix_data[] = {0, 0, 0, 0, 0, 0, 0, 1 << 11};
-    const int8x16_t pos0 = vld1q_s8(pos0_data);
-    const int8x16_t pos1 = vld1q_s8(pos1_data);
-    const int16x8_t mult = vld1q_s16(mult_data);
-    const int16x8_t mask = vdupq_n_s16((int16_t)0xf000);
-    const int16x8_t table_prefix = vld1q_s16(table_prefix_data);
+    aADPCMdecFromImpl(flags, state, rspa.buf.as_u8 + rspa.in);
+}
+
+void aADPCMdecFromImpl(uint8_t flags, ADPCM_STATE state, const uint8_t *source_addr) {
+    get_mixer_kernels()->adpcm_dec(flags, state, source_addr,
+                                   rspa.buf.as_s16 + rspa.out / sizeof(int16_t), ROUND_UP_32(rspa.nbytes));
+}
+
+// Each decode pass is stored the way aADPCMdec lays it out: 16 samples of initial state followed
+// by the decoded frames. A frame only depends on the two samples before it, so a pass can serve
+// any request whose state ends with the same two samples, which makes the cache bit exact.
+struct ADPCMCachePass {
+    int16_t *pcm;
+    int first_frame;
+};
+
+struct ADPCMCacheEntry {
+    const void *key;
+    const uint8_t *data;
+    int num_frames;
+    int loop_frame;
+    int16_t table[8][2][8];
+    struct ADPCMCachePass start;
+    struct ADPCMCachePass loop;
+    size_t size;
+    uint32_t last_use;
+    int16_t next; // index + 1 of the next entry in the bucket, 0 ends the chain
+};
+
+static struct {
+    struct ADPCMCacheEntry entries[ADPCM_CACHE_ENTRIES];
+    int16_t buckets[ADPCM_CACHE_BUCKETS];
+    size_t used;
+    uint32_t clock;
+} adpcm_cache;
+
+#ifdef AUDIO_WORKERS
+static pthread_mutex_t adpcm_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ADPCM_CACHE_LOCK() pthread_mutex_lock(&adpcm_cache_lock)
+#define ADPCM_CACHE_UNLOCK() pthread_mutex_unlock(&adpcm_cache_lock)
+#else
+#define ADPCM_CACHE_LOCK()
+#define ADPCM_CACHE_UNLOCK()
 #endif
-    uint8_t *in = rspa.buf.as_u8 + rspa.in;
-    int16_t *out = rspa.buf.as_s16 + rspa.out / sizeof(int16_t);
-    int nbytes = ROUND_UP_32(rspa.nbytes);
-    if (flags & A_INIT) {
-        memset(out, 0, 16 * sizeof(int16_t));
-    } else if (flags & A_LOOP) {
-        memcpy(out, rspa.adpcm_loop_state, 16 * sizeof(int16_t));
-    } else {
-        memcpy(out, state, 16 * sizeof(int16_t));
+
+static int16_t *adpcm_cache_decode(const struct ADPCMSampleInfo *sample, int first_frame, const int16_t *state_in) {
+    int nframes = sample->num_frames - first_frame;
+    int16_t *pcm = malloc((16 + nframes * 16) * sizeof(int16_t));
+    ADPCM_STATE state;
+
+    if (pcm != NULL) {
+        memcpy(state, state_in, sizeof(state));
+        get_mixer_kernels()->adpcm_dec(0, state, sample->data + first_frame * 9, pcm, nframes * 32);
     }
-    out += 16;
-#if HAS_SSE41
-    __m128i prev_interleaved = _mm_set1_epi32((uint16_t)out[-2] | ((uint16_t)out[-1] << 16));
-    //__m128i prev_interleaved = _mm_shuffle_epi32(_mm_loadu_si32(out - 2), 0); // GCC misses this?
-#elif HAS_NEON
-    int16x8_t result = vld1q_s16(out - 8);
-#endif
-    while (nbytes > 0) {
-        int shift = *in >> 4; // should be in 0..12
-        int table_index = *in++ & 0xf; // should be in 0..7
-        int16_t (*tbl)[8] = rspa.adpcm_table[table_index];
+    return pcm;
+}
+
+static unsigned adpcm_cache_bucket(const void *key) {
+    return (unsigned)((uintptr_t)key / 16 % ADPCM_CACHE_BUCKETS);
+}
+
+static void adpcm_cache_remove(int index) {
+    struct ADPCMCacheEntry *entry = &adpcm_cache.entries[index];
+    int16_t *link = &adpcm_cache.buckets[adpcm_cache_bucket(entry->key)];
+
+    while (*link != index + 1) {
+        link = &adpcm_cache.entries[*link - 1].next;
+    }
+    *link = entry->next;
+    free(entry->start.pcm);
+    free(entry->loop.pcm);
+    adpcm_cache.used -= entry->size;
+    memset(entry, 0, sizeof(*entry));
+}
+
+// Frees least recently used entries until size more bytes fit, and returns a free slot
+static int adpcm_cache_make_room(size_t size) {
+    for (;;) {
+        int free_index = -1;
+        int lru_index = -1;
         int i;
-#if HAS_SSE41
-        // The _mm_loadu_si64 instruction was added in GCC 9, and results in the same
-        // asm as the following instructions, so better be compatible with old GCC.
-        //__m128i inv = _mm_loadu_si64(in);
-        uint64_t v; memcpy(&v, in, 8);
-        __m128i inv = _mm_set_epi64x(0, v);
-        __m128i invec[2] = {_mm_shuffle_epi8(inv, pos0), _mm_shuffle_epi8(inv, pos1)};
-        __m128i tblvec0 = _mm_loadu_si128((const __m128i *)tbl[0]);
-        __m128i tblvec1 = _mm_loadu_si128((const __m128i *)(tbl[1]));
-        __m128i tbllo = _mm_unpacklo_epi16(tblvec0, tblvec1);
-        __m128i tblhi = _mm_unpackhi_epi16(tblvec0, tblvec1);
-        __m128i shiftcount = _mm_set_epi64x(0, 12 - shift); // _mm_cvtsi64_si128 does not exist on 32-bit x86
-        __m128i tblvec1_rev[8];
-
-        tblvec1_rev[0] = _mm_insert_epi16(_mm_shuffle_epi8(tblvec1, tblrev), 1 << 11, 7);
-        tblvec1_rev[1] = _mm_bsrli_si128(tblvec1_rev[0], 2);
-        tblvec1_rev[2] = _mm_bsrli_si128(tblvec1_rev[0], 4);
-        tblvec1_rev[3] = _mm_bsrli_si128(tblvec1_rev[0], 6);
-        tblvec1_rev[4] = _mm_bsrli_si128(tblvec1_rev[0], 8);
-        tblvec1_rev[5] = _mm_bsrli_si128(tblvec1_rev[0], 10);
-        tblvec1_rev[6] = _mm_bsrli_si128(tblvec1_rev[0], 12);
-        tblvec1_rev[7] = _mm_bsrli_si128(tblvec1_rev[0], 14);
-        in += 8;
-        for (i = 0; i < 2; i++) {
-            __m128i acc0 = _mm_madd_epi16(prev_interleaved, tbllo);
-            __m128i acc1 = _mm_madd_epi16(prev_interleaved, tblhi);
-            __m128i muls[8];
-            __m128i result;
-            invec[i] = _mm_sra_epi16(_mm_and_si128(_mm_mullo_epi16(invec[i], mult), mask), shiftcount);
-
-            muls[7] = _mm_madd_epi16(tblvec1_rev[0], invec[i]);
-            muls[6] = _mm_madd_epi16(tblvec1_rev[1], invec[i]);
-            muls[5] = _mm_madd_epi16(tblvec1_rev[2], invec[i]);
-            muls[4] = _mm_madd_epi16(tblvec1_rev[3], invec[i]);
-            muls[3] = _mm_madd_epi16(tblvec1_rev[4], invec[i]);
-            muls[2] = _mm_madd_epi16(tblvec1_rev[5], invec[i]);
-            muls[1] = _mm_madd_epi16(tblvec1_rev[6], invec[i]);
-            muls[0] = _mm_madd_epi16(tblvec1_rev[7], invec[i]);
-
-            acc0 = _mm_add_epi32(acc0, _mm_hadd_epi32(_mm_hadd_epi32(muls[0], muls[1]), _mm_hadd_epi32(muls[2], muls[3])));
-            acc1 = _mm_add_epi32(acc1, _mm_hadd_epi32(_mm_hadd_epi32(muls[4], muls[5]), _mm_hadd_epi32(muls[6], muls[7])));
-
-            acc0 = _mm_srai_epi32(acc0, 11);
-            acc1 = _mm_srai_epi32(acc1, 11);
-
-            result = _mm_packs_epi32(acc0, acc1);
-            _mm_storeu_si128((__m128i *)out, result);
-            out += 8;
-
-            prev_interleaved = _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 3, 3));
+
+        for (i = 0; i < ADPCM_CACHE_ENTRIES; i++) {
+            struct ADPCMCacheEntry *entry = &adpcm_cache.entries[i];
+            if (entry->key == NULL) {
+                free_index = i;
+            } else if (lru_index < 0 || adpcm_cache.clock - entry->last_use
+                                            > adpcm_cache.clock - adpcm_cache.entries[lru_index].last_use) {
+                lru_index = i;
+            }
         }
-#elif HAS_NEON
-        int8x8_t inv = vld1_s8((int8_t *)in);
-        int16x8_t tblvec[2] = {vld1q_s16(tbl[0]), vld1q_s16(tbl[1])};
-        int16x8_t invec[2] = {vreinterpretq_s16_s8(vcombine_s8(vtbl1_s8(inv, vget_low_s8(pos0)),
-                                                               vtbl1_s8(inv, vget_high_s8(pos0)))),
-                              vreinterpretq_s16_s8(vcombine_s8(vtbl1_s8(inv, vget_low_s8(pos1)),
-                                                               vtbl1_s8(inv, vget_high_s8(pos1))))};
-        int16x8_t shiftcount = vdupq_n_s16(shift - 12); // negative means right shift
-        int16x8_t tblvec1[8];
-
-        in += 8;
-        tblvec1[0] = vextq_s16(table_prefix, tblvec[1], 7);
-        invec[0] = vmulq_s16(invec[0], mult);
-        tblvec1[1] = vextq_s16(table_prefix, tblvec[1], 6);
-        invec[1] = vmulq_s16(invec[1], mult);
-        tblvec1[2] = vextq_s16(table_prefix, tblvec[1], 5);
-        tblvec1[3] = vextq_s16(table_prefix, tblvec[1], 4);
-        invec[0] = vandq_s16(invec[0], mask);
-        tblvec1[4] = vextq_s16(table_prefix, tblvec[1], 3);
-        invec[1] = vandq_s16(invec[1], mask);
-        tblvec1[5] = vextq_s16(table_prefix, tblvec[1], 2);
-        tblvec1[6] = vextq_s16(table_prefix, tblvec[1], 1);
-        invec[0] = vqshlq_s16(invec[0], shiftcount);
-        invec[1] = vqshlq_s16(invec[1], shiftcount);
-        tblvec1[7] = table_prefix;
-        for (i = 0; i < 2; i++) {
-            int32x4_t acc0;
-            int32x4_t acc1;
-
-            acc1 = vmull_lane_s16(vget_high_s16(tblvec[0]), vget_high_s16(result), 2);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec[1]), vget_high_s16(result), 3);
-            acc0 = vmull_lane_s16(vget_low_s16(tblvec[0]), vget_high_s16(result), 2);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec[1]), vget_high_s16(result), 3);
-
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[0]), vget_low_s16(invec[i]), 0);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[1]), vget_low_s16(invec[i]), 1);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[2]), vget_low_s16(invec[i]), 2);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[3]), vget_low_s16(invec[i]), 3);
-
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[0]), vget_low_s16(invec[i]), 0);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[1]), vget_low_s16(invec[i]), 1);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[2]), vget_low_s16(invec[i]), 2);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[3]), vget_low_s16(invec[i]), 3);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[4]), vget_high_s16(invec[i]), 0);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[5]), vget_high_s16(invec[i]), 1);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[6]), vget_high_s16(invec[i]), 2);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[7]), vget_high_s16(invec[i]), 3);
-
-            result = vcombine_s16(vqshrn_n_s32(acc0, 11), vqshrn_n_s32(acc1, 11));
-            vst1q_s16(out, result);
-            out += 8;
+        if (free_index >= 0 && adpcm_cache.used + size <= ADPCM_CACHE_BUDGET) {
+            return free_index;
         }
-#else
-        for (i = 0; i < 2; i++) {
-            int16_t ins[8];
-            int16_t prev1 = out[-1];
-            int16_t prev2 = out[-2];
-            int j, k;
-            for (j = 0; j < 4; j++) {
-                ins[j * 2] = (((*in >> 4) << 28) >> 28) << shift;
-                ins[j * 2 + 1] = (((*in++ & 0xf) << 28) >> 28) << shift;
-            }
-            for (j = 0; j < 8; j++) {
-                int32_t acc = tbl[0][j] * prev2 + tbl[1][j] * prev1 + (ins[j] << 11);
-                for (k = 0; k < j; k++) {
-                    acc += tbl[1][((j - k) - 1)] * ins[k];
-                }
-                acc >>= 11;
-                *out++ = clamp16(acc);
-            }
+        if (lru_index < 0) {
+            return -1;
         }
-#endif
-        nbytes -= 16 * sizeof(int16_t);
+        adpcm_cache_remove(lru_index);
     }
-    memcpy(state, out - 16, 16 * sizeof(int16_t));
 }
 
-void aResampleImpl(uint8_t flags, uint16_t pitch, RESAMPLE_STATE state) {
-    int16_t tmp[16];
-    int16_t *in_initial = rspa.buf.as_s16 + rspa.in / sizeof(int16_t);
-    int16_t *in = in_initial;
-    int16_t *out = rspa.buf.as_s16 + rspa.out / sizeof(int16_t);
-    int nbytes = ROUND_UP_16(rspa.nbytes);
-    uint32_t pitch_accumulator;
-    int i;
-#if !HAS_SSE41 && !HAS_NEON
-    int16_t *tbl;
-    int32_t sample;
-#endif
-    if (flags & A_INIT) {
-        memset(tmp, 0, 5 * sizeof(int16_t));
-    } else {
-        memcpy(tmp, state, 16 * sizeof(int16_t));
-    }
-    if (flags & 2) {
-        memcpy(in - 8, tmp + 8, 8 * sizeof(int16_t));
-        in -= tmp[5] / sizeof(int16_t);
-    }
-    in -= 4;
-    pitch_accumulator = (uint16_t)tmp[4];
-    memcpy(in, tmp, 4 * sizeof(int16_t));
-
-#if HAS_SSE41
-    __m128i multiples = _mm_setr_epi16(0, 2, 4, 6, 8, 10, 12, 14);
-    __m128i pitchvec = _mm_set1_epi16((int16_t)pitch);
-    __m128i pitchvec_8_steps = _mm_set1_epi32((pitch << 1) * 8);
-    __m128i pitchacclo_vec = _mm_set1_epi32((uint16_t)pitch_accumulator);
-    __m128i pl = _mm_mullo_epi16(multiples, pitchvec);
-    __m128i ph = _mm_mulhi_epu16(multiples, pitchvec);
-    __m128i acc_a = _mm_add_epi32(_mm_unpacklo_epi16(pl, ph), pitchacclo_vec);
-    __m128i acc_b = _mm_add_epi32(_mm_unpackhi_epi16(pl, ph), pitchacclo_vec);
-
-    do {
-        __m128i tbl_positions = _mm_srli_epi16(_mm_packus_epi32(
-            _mm_and_si128(acc_a, _mm_set1_epi32(0xffff)),
-            _mm_and_si128(acc_b, _mm_set1_epi32(0xffff))), 10);
-
-        __m128i in_positions = _mm_packus_epi32(_mm_srli_epi32(acc_a, 16), _mm_srli_epi32(acc_b, 16));
-        __m128i tbl_entries[4];
-        __m128i samples[4];
-
-        /*for (i = 0; i < 4; i++) {
-            tbl_entries[i] = _mm_castpd_si128(_mm_loadh_pd(_mm_load_sd(
-                (const double *)resample_table[_mm_extract_epi16(tbl_positions, 2 * i)]),
-                (const double *)resample_table[_mm_extract_epi16(tbl_positions, 2 * i + 1)]));
-
-            samples[i] = _mm_castpd_si128(_mm_loadh_pd(_mm_load_sd(
-                (const double *)&in[_mm_extract_epi16(in_positions, 2 * i)]),
-                (const double *)&in[_mm_extract_epi16(in_positions, 2 * i + 1)]));
-
-            samples[i] = _mm_mulhrs_epi16(samples[i], tbl_entries[i]);
-        }*/
-        tbl_entries[0] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 0)], resample_table[_mm_extract_epi16(tbl_positions, 1)]);
-        tbl_entries[1] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 2)], resample_table[_mm_extract_epi16(tbl_positions, 3)]);
-        tbl_entries[2] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 4)], resample_table[_mm_extract_epi16(tbl_positions, 5)]);
-        tbl_entries[3] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 6)], resample_table[_mm_extract_epi16(tbl_positions, 7)]);
-        samples[0] = LOADLH(&in[_mm_extract_epi16(in_positions, 0)], &in[_mm_extract_epi16(in_positions, 1)]);
-        samples[1] = LOADLH(&in[_mm_extract_epi16(in_positions, 2)], &in[_mm_extract_epi16(in_positions, 3)]);
-        samples[2] = LOADLH(&in[_mm_extract_epi16(in_positions, 4)], &in[_mm_extract_epi16(in_positions, 5)]);
-        samples[3] = LOADLH(&in[_mm_extract_epi16(in_positions, 6)], &in[_mm_extract_epi16(in_positions, 7)]);
-        samples[0] = _mm_mulhrs_epi16(samples[0], tbl_entries[0]);
-        samples[1] = _mm_mulhrs_epi16(samples[1], tbl_entries[1]);
-        samples[2] = _mm_mulhrs_epi16(samples[2], tbl_entries[2]);
-        samples[3] = _mm_mulhrs_epi16(samples[3], tbl_entries[3]);
-
-        _mm_storeu_si128((__m128i *)out, _mm_hadds_epi16(_mm_hadds_epi16(samples[0], samples[1]), _mm_hadds_epi16(samples[2], samples[3])));
-
-        acc_a = _mm_add_epi32(acc_a, pitchvec_8_steps);
-        acc_b = _mm_add_epi32(acc_b, pitchvec_8_steps);
-        out += 8;
-        nbytes -= 8 * sizeof(int16_t);
-    } while (nbytes > 0);
-    in += (uint16_t)_mm_extract_epi16(acc_a, 1);
-    pitch_accumulator = (uint16_t)_mm_extract_epi16(acc_a, 0);
-#elif HAS_NEON
-    static const uint16_t multiples_data[8] = {0, 2, 4, 6, 8, 10, 12, 14};
-    uint16x8_t multiples = vld1q_u16(multiples_data);
-    uint32x4_t pitchvec_8_steps = vdupq_n_u32((pitch << 1) * 8);
-    uint32x4_t pitchacclo_vec = vdupq_n_u32((uint16_t)pitch_accumulator);
-    uint32x4_t acc_a = vmlal_n_u16(pitchacclo_vec, vget_low_u16(multiples), pitch);
-    uint32x4_t acc_b = vmlal_n_u16(pitchacclo_vec, vget_high_u16(multiples), pitch);
-
-    do {
-        uint16x8x2_t unzipped = vuzpq_u16(vreinterpretq_u16_u32(acc_a), vreinterpretq_u16_u32(acc_b));
-        uint16x8_t tbl_positions = vshrq_n_u16(unzipped.val[0], 10);
-        uint16x8_t in_positions = unzipped.val[1];
-        int16x8_t tbl_entries[4];
-        int16x8_t samples[4];
-        int16x8x2_t unzipped1;
-        int16x8x2_t unzipped2;
-
-        tbl_entries[0] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 0)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 1)]));
-        tbl_entries[1] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 2)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 3)]));
-        tbl_entries[2] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 4)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 5)]));
-        tbl_entries[3] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 6)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 7)]));
-        samples[0] = vcombine_s16(vld1_s16(&in[vgetq_lane_u16(in_positions, 0)]), vld1_s16(&in[vgetq_lane_u16(in_positions, 1)]));
-        samples[1] = vcombine_s16(vld1_s16(&in[vgetq_lane_u16(in_positions, 2)]), vld1_s16(&in[vgetq_lane_u16(in_positions, 3)]));
-        samples[2] = vcombine_s16(vld1_s16(&in[vgetq_lane_u16(in_positions, 4)]), vld1_s16(&in[vgetq_lane_u16(in_positions, 5)]));
-        samples[3] = vcombine_s16(vld1_s16(&in[vgetq_lane_u16(in_positions, 6)]), vld1_s16(&in[vgetq_lane_u16(in_positions, 7)]));
-        samples[0] = vqrdmulhq_s16(samples[0], tbl_entries[0]);
-        samples[1] = vqrdmulhq_s16(samples[1], tbl_entries[1]);
-        samples[2] = vqrdmulhq_s16(samples[2], tbl_entries[2]);
-        samples[3] = vqrdmulhq_s16(samples[3], tbl_entries[3]);
-
-        unzipped1 = vuzpq_s16(samples[0], samples[1]);
-        unzipped2 = vuzpq_s16(samples[2], samples[3]);
-        samples[0] = vqaddq_s16(unzipped1.val[0], unzipped1.val[1]);
-        samples[1] = vqaddq_s16(unzipped2.val[0], unzipped2.val[1]);
-        unzipped1 = vuzpq_s16(samples[0], samples[1]);
-        samples[0] = vqaddq_s16(unzipped1.val[0], unzipped1.val[1]);
-
-        vst1q_s16(out, samples[0]);
-
-        acc_a = vaddq_u32(acc_a, pitchvec_8_steps);
-        acc_b = vaddq_u32(acc_b, pitchvec_8_steps);
-        out += 8;
-        nbytes -= 8 * sizeof(int16_t);
-    } while (nbytes > 0);
-    in += vgetq_lane_u16(vreinterpretq_u16_u32(acc_a), 1);
-    pitch_accumulator = vgetq_lane_u16(vreinterpretq_u16_u32(acc_a), 0);
-#else
-    do {
-        for (i = 0; i < 8; i++) {
-            tbl = resample_table[pitch_accumulator * 64 >> 16];
-            sample = ((in[0] * tbl[0] + 0x4000) >> 15) +
-                     ((in[1] * tbl[1] + 0x4000) >> 15) +
-                     ((in[2] * tbl[2] + 0x4000) >> 15) +
-                     ((in[3] * tbl[3] + 0x4000) >> 15);
-            *out++ = clamp16(sample);
-
-            pitch_accumulator += (pitch << 1);
-            in += pitch_accumulator >> 16;
-            pitch_accumulator %= 0x10000;
+static struct ADPCMCacheEntry *adpcm_cache_get(const struct ADPCMSampleInfo *sample) {
+    static const int16_t zero_state[16];
+    unsigned bucket = adpcm_cache_bucket(sample->key);
+    struct ADPCMCacheEntry *entry;
+    size_t size;
+    int index;
+
+    for (index = adpcm_cache.buckets[bucket] - 1; index >= 0; index = entry->next - 1) {
+        entry = &adpcm_cache.entries[index];
+        if (entry->key == sample->key) {
+            // The same bank may have been reloaded with another sample or book at this address
+            if (entry->data == sample->data && entry->num_frames == sample->num_frames
+                && entry->loop_frame == sample->loop_frame
+                && memcmp(entry->table, rspa.adpcm_table, sizeof(rspa.adpcm_table)) == 0) {
+                entry->last_use = ++adpcm_cache.clock;
+                return entry;
+            }
+            adpcm_cache_remove(index);
+            break;
         }
-        nbytes -= 8 * sizeof(int16_t);
-    } while (nbytes > 0);
-#endif
+    }
 
-    state[4] = (int16_t)pitch_accumulator;
-    memcpy(state, in, 4 * sizeof(int16_t));
-    i = (in - in_initial + 4) & 7;
-    in -= i;
-    if (i != 0) {
-        i = -8 - i;
+    if (sample->num_frames <= 0 || sample->num_frames > ADPCM_CACHE_MAX_FRAMES
+        || sample->loop_frame >= sample->num_frames) {
+        return NULL;
+    }
+    size = (16 + sample->num_frames * 16) * sizeof(int16_t);
+    if (sample->loop_frame >= 0) {
+        size += (16 + (sample->num_frames - sample->loop_frame) * 16) * sizeof(int16_t);
+    }
+    if ((index = adpcm_cache_make_room(size)) < 0) {
+        return NULL;
     }
-    state[5] = i;
-    memcpy(state + 8, in, 8 * sizeof(int16_t));
-}
 
+    entry = &adpcm_cache.entries[index];
+    entry->start.pcm = adpcm_cache_decode(sample, 0, zero_state);
+    if (sample->loop_frame >= 0) {
+        entry->loop.pcm = adpcm_cache_decode(sample, sample->loop_frame, sample->loop_state);
+        entry->loop.first_frame = sample->loop_frame;
+    }
+    if (entry->start.pcm == NULL || (sample->loop_frame >= 0 && entry->loop.pcm == NULL)) {
+        free(entry->start.pcm);
+        free(entry->loop.pcm);
+        memset(entry, 0, sizeof(*entry));
+        return NULL;
+    }
+    entry->key = sample->key;
+    entry->data = sample->data;
+    entry->num_frames = sample->num_frames;
+    entry->loop_frame = sample->loop_frame;
+    memcpy(entry->table, rspa.adpcm_table, sizeof(rspa.adpcm_table));
+    entry->size = size;
+    entry->last_use = ++adpcm_cache.clock;
+    entry->next = adpcm_cache.buckets[bucket];
+    adpcm_cache.buckets[bucket] = index + 1;
+    adpcm_cache.used += size;
+    return entry;
+}
 
-void aEnvMixerImpl(uint8_t flags, ENVMIX_STATE state) {
-    int16_t *in = rspa.buf.as_s16 + rspa.in / sizeof(int16_t);
-    int16_t *dry[2] = {rspa.buf.as_s16 + rspa.out / sizeof(int16_t), rspa.buf.as_s16 + rspa.dry_right / sizeof(int16_t)};
-    int16_t *wet[2] = {rspa.buf.as_s16 + rspa.wet_left / sizeof(int16_t), rspa.buf.as_s16 + rspa.wet_right / sizeof(int16_t)};
-    int nbytes = ROUND_UP_16(rspa.nbytes);
+static bool adpcm_cache_pass_matches(const struct ADPCMCachePass *pass, const int16_t *state_in, int frame,
+                                     int nframes, int num_frames) {
+    const int16_t *prev;
 
-#if HAS_SSE41
-    __m128 vols[2][2];
-    __m128i dry_factor;
-    __m128i wet_factor;
-    __m128 target[2];
-    __m128 rate[2];
-    __m128i in_loaded;
-    __m128i vol_s16;
-    bool increasing[2];
+    if (pass->pcm == NULL || frame < pass->first_frame || frame + nframes > num_frames) {
+        return false;
+    }
+    prev = pass->pcm + 16 + (frame - pass->first_frame) * 16 - 2;
+    return prev[0] == state_in[14] && prev[1] == state_in[15];
+}
 
-    int c;
+void aADPCMdecSampleImpl(uint8_t flags, ADPCM_STATE state, const uint8_t *source_addr,
+                         const struct ADPCMSampleInfo *sample, int frame) {
+    static const int16_t zero_state[16];
+    int16_t *out = rspa.buf.as_s16 + rspa.out / sizeof(int16_t);
+    int nframes = ROUND_UP_32(rspa.nbytes) / 32;
+    const int16_t *state_in;
+    struct ADPCMCacheEntry *entry;
+    const struct ADPCMCachePass *pass;
+
+    if (nframes == 0) {
+        aADPCMdecFromImpl(flags, state, source_addr);
+        return;
+    }
+    ADPCM_CACHE_LOCK();
+    if ((entry = adpcm_cache_get(sample)) == NULL) {
+        ADPCM_CACHE_UNLOCK();
+        aADPCMdecFromImpl(flags, state, source_addr);
+        return;
+    }
 
     if (flags & A_INIT) {
-        float vol_init[2] = {rspa.vol[0], rspa.vol[1]};
-        float rate_float[2] = {(float)rspa.rate[0] * (1.0f / 65536.0f), (float)rspa.rate[1] * (1.0f / 65536.0f)};
-        float step_diff[2] = {vol_init[0] * (rate_float[0] - 1.0f), vol_init[1] * (rate_float[1] - 1.0f)};
-
-        for (c = 0; c < 2; c++) {
-            vols[c][0] = _mm_add_ps(
-                _mm_set_ps1(vol_init[c]),
-                _mm_mul_ps(_mm_set1_ps(step_diff[c]), _mm_setr_ps(1.0f / 8.0f, 2.0f / 8.0f, 3.0f / 8.0f, 4.0f / 8.0f)));
-            vols[c][1] = _mm_add_ps(
-                _mm_set_ps1(vol_init[c]),
-                _mm_mul_ps(_mm_set1_ps(step_diff[c]), _mm_setr_ps(5.0f / 8.0f, 6.0f / 8.0f, 7.0f / 8.0f, 8.0f / 8.0f)));
-
-            increasing[c] = rate_float[c] >= 1.0f;
-            target[c] = _mm_set1_ps(rspa.target[c]);
-            rate[c] = _mm_set1_ps(rate_float[c]);
-        }
-
-        dry_factor = _mm_set1_epi16(rspa.vol_dry);
-        wet_factor = _mm_set1_epi16(rspa.vol_wet);
-
-        memcpy(state + 32, &rate_float[0], 4);
-        memcpy(state + 34, &rate_float[1], 4);
-        state[36] = rspa.target[0];
-        state[37] = rspa.target[1];
-        state[38] = rspa.vol_dry;
-        state[39] = rspa.vol_wet;
+        state_in = zero_state;
+    } else if (flags & A_LOOP) {
+        state_in = *rspa.adpcm_loop_state;
     } else {
-        float floats[2];
-        vols[0][0] = _mm_loadu_ps((const float *)state);
-        vols[0][1] = _mm_loadu_ps((const float *)(state + 8));
-        vols[1][0] = _mm_loadu_ps((const float *)(state + 16));
-        vols[1][1] = _mm_loadu_ps((const float *)(state + 24));
-        memcpy(floats, state + 32, 8);
-        rate[0] = _mm_set1_ps(floats[0]);
-        rate[1] = _mm_set1_ps(floats[1]);
-        increasing[0] = floats[0] >= 1.0f;
-        increasing[1] = floats[1] >= 1.0f;
-        target[0] = _mm_set1_ps(state[36]);
-        target[1] = _mm_set1_ps(state[37]);
-        dry_factor = _mm_set1_epi16(state[38]);
-        wet_factor = _mm_set1_epi16(state[39]);
-    }
-    do {
-        in_loaded = _mm_loadu_si128((const __m128i *)in);
-        in += 8;
-        for (c = 0; c < 2; c++) {
-            if (increasing[c]) {
-                vols[c][0] = _mm_min_ps(vols[c][0], target[c]);
-                vols[c][1] = _mm_min_ps(vols[c][1], target[c]);
-            } else {
-                vols[c][0] = _mm_max_ps(vols[c][0], target[c]);
-                vols[c][1] = _mm_max_ps(vols[c][1], target[c]);
-            }
+        state_in = state;
+    }
+    if (adpcm_cache_pass_matches(&entry->start, state_in, frame, nframes, entry->num_frames)) {
+        pass = &entry->start;
+    } else if (adpcm_cache_pass_matches(&entry->loop, state_in, frame, nframes, entry->num_frames)) {
+        pass = &entry->loop;
+    } else {
+        ADPCM_CACHE_UNLOCK();
+        aADPCMdecFromImpl(flags, state, source_addr);
+        return;
+    }
 
-            vol_s16 = _mm_packs_epi32(_mm_cvtps_epi32(vols[c][0]), _mm_cvtps_epi32(vols[c][1]));
-            _mm_storeu_si128((__m128i *)dry[c],
-                             _mm_adds_epi16(
-                                 _mm_loadu_si128((const __m128i *)dry[c]),
-                                 _mm_mulhrs_epi16(in_loaded, _mm_mulhrs_epi16(vol_s16, dry_factor))));
-            dry[c] += 8;
-
-            if (flags & A_AUX) {
-                _mm_storeu_si128((__m128i *)wet[c],
-                                 _mm_adds_epi16(
-                                     _mm_loadu_si128((const __m128i *)wet[c]),
-                                     _mm_mulhrs_epi16(in_loaded, _mm_mulhrs_epi16(vol_s16, wet_factor))));
-                wet[c] += 8;
-            }
+    memcpy(out, state_in, 16 * sizeof(int16_t));
+    memcpy(out + 16, pass->pcm + 16 + (frame - pass->first_frame) * 16, nframes * 16 * sizeof(int16_t));
+    ADPCM_CACHE_UNLOCK();
+    memcpy(state, out + nframes * 16, 16 * sizeof(int16_t));
+}
 
-            vols[c][0] = _mm_mul_ps(vols[c][0], rate[c]);
-            vols[c][1] = _mm_mul_ps(vols[c][1], rate[c]);
-        }
+void aResampleImpl(uint8_t flags, uint16_t pitch, RESAMPLE_STATE state) {
+    get_mixer_kernels()->resample(flags, pitch, state);
+}
 
-        nbytes -= 8 * sizeof(int16_t);
-    } while (nbytes > 0);
+enum MixerBusOpType {
+    BUS_OP_ENV_MIXER,
+    BUS_OP_MIX
+};
 
-    _mm_storeu_ps((float *)state, vols[0][0]);
-    _mm_storeu_ps((float *)(state + 8), vols[0][1]);
-    _mm_storeu_ps((float *)(state + 16), vols[1][0]);
-    _mm_storeu_ps((float *)(state + 24), vols[1][1]);
-#elif HAS_NEON
-    float32x4_t vols[2][2];
-    int16_t dry_factor;
-    int16_t wet_factor;
-    float32x4_t target[2];
-    float rate[2];
-    int16x8_t in_loaded;
-    int16x8_t vol_s16;
-    bool increasing[2];
+// Followed by nbytes of input samples in the log
+struct MixerBusOp {
+    uint8_t type;
+    uint8_t flags;
+    int16_t gain;
+    uint16_t nbytes;
+    uint16_t out[4]; // dry left, dry right, wet left, wet right; MIXER_SCRATCH_OUT if not on the bus
+    int16_t vol[2];
+    int16_t target[2];
+    int32_t rate[2];
+    int16_t vol_dry;
+    int16_t vol_wet;
+    ENVMIX_STATE state; // as it was before the env mixer ran
+};
 
-    int c;
+static MIXER_THREAD_LOCAL struct {
+    struct MixerBusLog *log;
+    uint16_t start;
+    uint16_t end;
+} bus_record;
 
-    if (flags & A_INIT) {
-        float vol_init[2] = {rspa.vol[0], rspa.vol[1]};
-        float rate_float[2] = {(float)rspa.rate[0] * (1.0f / 65536.0f), (float)rspa.rate[1] * (1.0f / 65536.0f)};
-        float step_diff[2] = {vol_init[0] * (rate_float[0] - 1.0f), vol_init[1] * (rate_float[1] - 1.0f)};
-        static const float step_dividers_data[2][4] = {{1.0f / 8.0f, 2.0f / 8.0f, 3.0f / 8.0f, 4.0f / 8.0f},
-                                                      {5.0f / 8.0f, 6.0f / 8.0f, 7.0f / 8.0f, 8.0f / 8.0f}};
-        float32x4_t step_dividers[2] = {vld1q_f32(step_dividers_data[0]), vld1q_f32(step_dividers_data[1])};
-
-        for (c = 0; c < 2; c++) {
-            vols[c][0] = vaddq_f32(vdupq_n_f32(vol_init[c]), vmulq_n_f32(step_dividers[0], step_diff[c]));
-            vols[c][1] = vaddq_f32(vdupq_n_f32(vol_init[c]), vmulq_n_f32(step_dividers[1], step_diff[c]));
-            increasing[c] = rate_float[c] >= 1.0f;
-            target[c] = vdupq_n_f32(rspa.target[c]);
-            rate[c] = rate_float[c];
-        }
+static bool mixer_on_bus(uint16_t addr, int nbytes) {
+    return addr < bus_record.end && addr + nbytes > bus_record.start;
+}
 
-        dry_factor = rspa.vol_dry;
-        wet_factor = rspa.vol_wet;
+static struct MixerBusOp *mixer_bus_log_append(enum MixerBusOpType type, uint16_t in_addr, int nbytes) {
+    struct MixerBusLog *log = bus_record.log;
+    size_t size = sizeof(struct MixerBusOp) + ROUND_UP_16(nbytes);
+    struct MixerBusOp *op;
 
-        memcpy(state + 32, &rate_float[0], 4);
-        memcpy(state + 34, &rate_float[1], 4);
-        state[36] = rspa.target[0];
-        state[37] = rspa.target[1];
-        state[38] = rspa.vol_dry;
-        state[39] = rspa.vol_wet;
-    } else {
-        vols[0][0] = vreinterpretq_f32_s16(vld1q_s16(state));
-        vols[0][1] = vreinterpretq_f32_s16(vld1q_s16(state + 8));
-        vols[1][0] = vreinterpretq_f32_s16(vld1q_s16(state + 16));
-        vols[1][1] = vreinterpretq_f32_s16(vld1q_s16(state + 24));
-        memcpy(&rate[0], state + 32, 4);
-        memcpy(&rate[1], state + 34, 4);
-        increasing[0] = rate[0] >= 1.0f;
-        increasing[1] = rate[1] >= 1.0f;
-        target[0] = vdupq_n_f32(state[36]);
-        target[1] = vdupq_n_f32(state[37]);
-        dry_factor = state[38];
-        wet_factor = state[39];
-    }
-
-    do {
-        in_loaded = vld1q_s16(in);
-        in += 8;
-        for (c = 0; c < 2; c++) {
-            if (increasing[c]) {
-                vols[c][0] = vminq_f32(vols[c][0], target[c]);
-                vols[c][1] = vminq_f32(vols[c][1], target[c]);
-            } else {
-                vols[c][0] = vmaxq_f32(vols[c][0], target[c]);
-                vols[c][1] = vmaxq_f32(vols[c][1], target[c]);
-            }
+    if (log->size + size > log->capacity) {
+        size_t capacity = log->capacity != 0 ? log->capacity * 2 : 16384;
+        uint8_t *data;
 
-            vol_s16 = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(vols[c][0])), vqmovn_s32(vcvtq_s32_f32(vols[c][1])));
-            vst1q_s16(dry[c], vqaddq_s16(vld1q_s16(dry[c]), vqrdmulhq_s16(in_loaded, vqrdmulhq_n_s16(vol_s16, dry_factor))));
-            dry[c] += 8;
-            if (flags & A_AUX) {
-                vst1q_s16(wet[c], vqaddq_s16(vld1q_s16(wet[c]), vqrdmulhq_s16(in_loaded, vqrdmulhq_n_s16(vol_s16, wet_factor))));
-                wet[c] += 8;
-            }
-            vols[c][0] = vmulq_n_f32(vols[c][0], rate[c]);
-            vols[c][1] = vmulq_n_f32(vols[c][1], rate[c]);
+        while (capacity < log->size + size) {
+            capacity *= 2;
         }
+        if ((data = realloc(log->data, capacity)) == NULL) {
+            return NULL;
+        }
+        log->data = data;
+        log->capacity = capacity;
+    }
 
-        nbytes -= 8 * sizeof(int16_t);
-    } while (nbytes > 0);
+    op = (struct MixerBusOp *)(log->data + log->size);
+    log->size += size;
+    memset(op, 0, sizeof(*op));
+    op->type = type;
+    op->nbytes = nbytes;
+    memcpy(op + 1, rspa.buf.as_u8 + in_addr, nbytes);
+    return op;
+}
 
-    vst1q_s16(state, vreinterpretq_s16_f32(vols[0][0]));
-    vst1q_s16(state + 8, vreinterpretq_s16_f32(vols[0][1]));
-    vst1q_s16(state + 16, vreinterpretq_s16_f32(vols[1][0]));
-    vst1q_s16(state + 24, vreinterpretq_s16_f32(vols[1][1]));
-#else
-    int16_t target[2];
-    int32_t rate[2];
-    int16_t vol_dry, vol_wet;
+void mixer_record_bus(struct MixerBusLog *log, uint16_t start, uint16_t end) {
+    if (log != NULL) {
+        log->size = 0;
+    }
+    bus_record.log = log;
+    bus_record.start = start;
+    bus_record.end = end;
+}
 
-    int32_t step_diff[2];
-    int32_t vols[2][8];
+void mixer_replay_bus(const struct MixerBusLog *log) {
+    const struct MixerKernels *kernels = get_mixer_kernels();
+    size_t pos = 0;
 
-    int c, i;
+    while (pos < log->size) {
+        const struct MixerBusOp *op = (const struct MixerBusOp *)(log->data + pos);
 
-    if (flags & A_INIT) {
-        target[0] = rspa.target[0];
-        target[1] = rspa.target[1];
-        rate[0] = rspa.rate[0];
-        rate[1] = rspa.rate[1];
-        vol_dry = rspa.vol_dry;
-        vol_wet = rspa.vol_wet;
-        step_diff[0] = rspa.vol[0] * (rate[0] - 0x10000) / 8;
-        step_diff[1] = rspa.vol[0] * (rate[1] - 0x10000) / 8;
-
-        for (i = 0; i < 8; i++) {
-            vols[0][i] = clamp32((int64_t)(rspa.vol[0] << 16) + step_diff[0] * (i + 1));
-            vols[1][i] = clamp32((int64_t)(rspa.vol[1] << 16) + step_diff[1] * (i + 1));
+        memcpy(rspa.buf.as_u8 + MIXER_SCRATCH_IN, op + 1, op->nbytes);
+        rspa.nbytes = op->nbytes;
+        if (op->type == BUS_OP_MIX) {
+            kernels->mix(op->gain, MIXER_SCRATCH_IN, op->out[0]);
+        } else {
+            ENVMIX_STATE state;
+
+            rspa.in = MIXER_SCRATCH_IN;
+            rspa.out = op->out[0];
+            rspa.dry_right = op->out[1];
+            rspa.wet_left = op->out[2];
+            rspa.wet_right = op->out[3];
+            memcpy(rspa.vol, op->vol, sizeof(rspa.vol));
+            memcpy(rspa.target, op->target, sizeof(rspa.target));
+            memcpy(rspa.rate, op->rate, sizeof(rspa.rate));
+            rspa.vol_dry = op->vol_dry;
+            rspa.vol_wet = op->vol_wet;
+            memcpy(state, op->state, sizeof(state));
+            kernels->env_mixer(op->flags, state);
         }
-    } else {
-        memcpy(vols[0], state, 32);
-        memcpy(vols[1], state + 16, 32);
-        target[0] = state[32];
-        target[1] = state[35];
-        rate[0] = (state[33] << 16) | (uint16_t)state[34];
-        rate[1] = (state[36] << 16) | (uint16_t)state[37];
-        vol_dry = state[38];
-        vol_wet = state[39];
-    }
-
-    do {
-        for (c = 0; c < 2; c++) {
-            for (i = 0; i < 8; i++) {
-                if ((rate[c] >> 16) > 0) {
-                    // Increasing volume
-                    if ((vols[c][i] >> 16) > target[c]) {
-                        vols[c][i] = target[c] << 16;
-                    }
-                } else {
-                    // Decreasing volume
-                    if ((vols[c][i] >> 16) < target[c]) {
-                        vols[c][i] = target[c] << 16;
-                    }
-                }
-                dry[c][i] = clamp16((dry[c][i] * 0x7fff + in[i] * (((vols[c][i] >> 16) * vol_dry + 0x4000) >> 15) + 0x4000) >> 15);
-                if (flags & A_AUX) {
-                    wet[c][i] = clamp16((wet[c][i] * 0x7fff + in[i] * (((vols[c][i] >> 16) * vol_wet + 0x4000) >> 15) + 0x4000) >> 15);
-                }
-                vols[c][i] = clamp32((int64_t)vols[c][i] * rate[c] >> 16);
-            }
+        pos += sizeof(*op) + ROUND_UP_16(op->nbytes);
+    }
+}
 
-            dry[c] += 8;
-            if (flags & A_AUX) {
-                wet[c] += 8;
-            }
+// Runs the env mixer for the outputs off the bus, and logs it for the ones on it
+static void env_mixer_record(uint8_t flags, ENVMIX_STATE state) {
+    uint16_t *outs[4] = { &rspa.out, &rspa.dry_right, &rspa.wet_left, &rspa.wet_right };
+    int num_outs = (flags & A_AUX) ? 4 : 2;
+    int nbytes = ROUND_UP_16(rspa.nbytes);
+    uint16_t saved[4];
+    struct MixerBusOp *op;
+    bool any_on_bus = false;
+    int i;
+
+    for (i = 0; i < num_outs; i++) {
+        any_on_bus = any_on_bus || mixer_on_bus(*outs[i], nbytes);
+    }
+    if (!any_on_bus) {
+        get_mixer_kernels()->env_mixer(flags, state);
+        return;
+    }
+
+    op = mixer_bus_log_append(BUS_OP_ENV_MIXER, rspa.in, nbytes);
+    if (op != NULL) {
+        op->flags = flags;
+        memcpy(op->vol, rspa.vol, sizeof(rspa.vol));
+        memcpy(op->target, rspa.target, sizeof(rspa.target));
+        memcpy(op->rate, rspa.rate, sizeof(rspa.rate));
+        op->vol_dry = rspa.vol_dry;
+        op->vol_wet = rspa.vol_wet;
+        memcpy(op->state, state, sizeof(op->state));
+    }
+    for (i = 0; i < 4; i++) {
+        bool on_bus = i < num_outs && mixer_on_bus(*outs[i], nbytes);
+
+        saved[i] = *outs[i];
+        if (op != NULL) {
+            op->out[i] = on_bus ? saved[i] : MIXER_SCRATCH_OUT;
+        }
+        if (on_bus) {
+            *outs[i] = MIXER_SCRATCH_OUT;
         }
+    }
 
-        nbytes -= 16;
-        in += 8;
-    } while (nbytes > 0);
-
-    memcpy(state, vols[0], 32);
-    memcpy(state + 16, vols[1], 32);
-    state[32] = target[0];
-    state[35] = target[1];
-    state[33] = (int16_t)(rate[0] >> 16);
-    state[34] = (int16_t)rate[0];
-    state[36] = (int16_t)(rate[1] >> 16);
-    state[37] = (int16_t)rate[1];
-    state[38] = vol_dry;
-    state[39] = vol_wet;
-#endif
+    // Still needed here for the state and for outputs that later steps of the note read back
+    get_mixer_kernels()->env_mixer(flags, state);
+
+    for (i = 0; i < 4; i++) {
+        *outs[i] = saved[i];
+    }
+}
+
+void aEnvMixerImpl(uint8_t flags, ENVMIX_STATE state) {
+    if (bus_record.log != NULL) {
+        env_mixer_record(flags, state);
+        return;
+    }
+    get_mixer_kernels()->env_mixer(flags, state);
 }
 
 void aMixImpl(int16_t gain, uint16_t in_addr, uint16_t out_addr) {
     int nbytes = ROUND_UP_32(rspa.nbytes);
-    int16_t *in = rspa.buf.as_s16 + in_addr / sizeof(int16_t);
-    int16_t *out = rspa.buf.as_s16 + out_addr / sizeof(int16_t);
-#if HAS_SSE41
-    __m128i gain_vec = _mm_set1_epi16(gain);
-#elif !HAS_NEON
-    int i;
-    int32_t sample;
-#endif
-
-#if !HAS_NEON
-    if (gain == -0x8000) {
-        while (nbytes > 0) {
-#if HAS_SSE41
-            __m128i out1, out2, in1, in2;
-            out1 = _mm_loadu_si128((const __m128i *)out);
-            out2 = _mm_loadu_si128((const __m128i *)(out + 8));
-            in1 = _mm_loadu_si128((const __m128i *)in);
-            in2 = _mm_loadu_si128((const __m128i *)(in + 8));
-
-            out1 = _mm_subs_epi16(out1, in1);
-            out2 = _mm_subs_epi16(out2, in2);
 
-            _mm_storeu_si128((__m128i *)out, out1);
-            _mm_storeu_si128((__m128i *)(out + 8), out2);
-
-            out += 16;
-            in += 16;
-#else
-            for (i = 0; i < 16; i++) {
-                sample = *out - *in++;
-                *out++ = clamp16(sample);
-            }
-#endif
+    if (bus_record.log != NULL && mixer_on_bus(out_addr, nbytes)) {
+        struct MixerBusOp *op = mixer_bus_log_append(BUS_OP_MIX, in_addr, nbytes);
+        if (op != NULL) {
+            op->gain = gain;
+            op->out[0] = out_addr;
+        }
+        return;
+    }
+    get_mixer_kernels()->mix(gain, in_addr, out_addr);
+}
 
-            nbytes -= 16 * sizeof(int16_t);
+void mixer_downsample(int16_t *dest, const int16_t *src, int count, int step) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    if (step == 2) {
+        // Sign-extend the even samples of each pair and pack them back together
+        for (; i + 8 <= count; i += 8) {
+            __m128i lo = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+            __m128i hi = _mm_loadu_si128((const __m128i *)(src + 2 * i + 8));
+            lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+            hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+            _mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(lo, hi));
+        }
+    }
+#elif HAS_NEON
+    if (step == 2) {
+        for (; i + 8 <= count; i += 8) {
+            vst1q_s16(dest + i, vld2q_s16(src + 2 * i).val[0]);
         }
     }
 #endif
+    for (; i < count; i++) {
+        dest[i] = src[i * step];
+    }
+}
 
-    while (nbytes > 0) {
-#if HAS_SSE41
-        __m128i out1, out2, in1, in2;
-        out1 = _mm_loadu_si128((const __m128i *)out);
-        out2 = _mm_loadu_si128((const __m128i *)(out + 8));
-        in1 = _mm_loadu_si128((const __m128i *)in);
-        in2 = _mm_loadu_si128((const __m128i *)(in + 8));
+bool mixer_reverb_fdn_init(struct ReverbFDN *fdn, int delay, int rate) {
+    // Mutually prime-ish fractions of the delay, so the echoes of the lines don't line up
+    static const float line_lengths[REVERB_FDN_LINES] = {
+        1.0f, 0.9311f, 0.8713f, 0.8017f, 0.7429f, 0.6821f, 0.6133f, 0.5527f
+    };
+    int total = 0;
+    int i;
 
-        out1 = _mm_adds_epi16(out1, _mm_mulhrs_epi16(in1, gain_vec));
-        out2 = _mm_adds_epi16(out2, _mm_mulhrs_epi16(in2, gain_vec));
+    free(fdn->buf);
+    memset(fdn, 0, sizeof(*fdn));
+    for (i = 0; i < REVERB_FDN_LINES; i++) {
+        fdn->length[i] = (int)(delay * line_lengths[i]) | 1;
+        total += fdn->length[i];
+    }
+    if ((fdn->buf = calloc(total, sizeof(float))) == NULL) {
+        return false;
+    }
+    for (i = 0, total = 0; i < REVERB_FDN_LINES; i++) {
+        fdn->line[i] = fdn->buf + total;
+        total += fdn->length[i];
+    }
+    fdn->damping = 1.0f - expf(-6.2831853f * REVERB_FDN_DAMPING_HZ / rate);
+    fdn->delay = delay;
+    return true;
+}
 
-        _mm_storeu_si128((__m128i *)out, out1);
-        _mm_storeu_si128((__m128i *)(out + 8), out2);
+// Scales the line gains so that, like the N64 ring buffer, the reverb loses the fraction
+// gain / 0x8000 of its level every delay
+static void reverb_fdn_set_gain(struct ReverbFDN *fdn, uint16_t gain) {
+    float decay = gain / 32768.0f;
+    int i;
 
-        out += 16;
-        in += 16;
-#elif HAS_NEON
-        int16x8_t out1, out2, in1, in2;
-        out1 = vld1q_s16(out);
-        out2 = vld1q_s16(out + 8);
-        in1 = vld1q_s16(in);
-        in2 = vld1q_s16(in + 8);
+    if (decay > 0.98f) {
+        decay = 0.98f;
+    }
+    for (i = 0; i < REVERB_FDN_LINES; i++) {
+        fdn->feedback[i] = decay > 0.0f ? powf(decay, (float)fdn->length[i] / fdn->delay) : 0.0f;
+    }
+    fdn->gain = gain;
+}
 
-        out1 = vqaddq_s16(out1, vqrdmulhq_n_s16(in1, gain));
-        out2 = vqaddq_s16(out2, vqrdmulhq_n_s16(in2, gain));
+void aReverbFDNImpl(struct ReverbFDN *fdn, uint16_t gain) {
+    int count = rspa.nbytes / sizeof(int16_t);
+    int16_t *dry[2] = { rspa.buf.as_s16 + rspa.out / sizeof(int16_t),
+                        rspa.buf.as_s16 + rspa.dry_right / sizeof(int16_t) };
+    int16_t *wet[2] = { rspa.buf.as_s16 + rspa.wet_left / sizeof(int16_t),
+                        rspa.buf.as_s16 + rspa.wet_right / sizeof(int16_t) };
+    int i;
+    int j;
 
-        vst1q_s16(out, out1);
-        vst1q_s16(out + 8, out2);
+    if (fdn->buf == NULL) {
+        return;
+    }
+    if (gain != fdn->gain) {
+        reverb_fdn_set_gain(fdn, gain);
+    }
 
-        out += 16;
-        in += 16;
-#else
-        for (i = 0; i < 16; i++) {
-            sample = ((*out * 0x7fff + *in++ * gain) + 0x4000) >> 15;
-            *out++ = clamp16(sample);
+    for (i = 0; i < count; i++) {
+        float y[REVERB_FDN_LINES];
+        float out[2] = { 0.0f, 0.0f };
+        float in[2] = { wet[0][i], wet[1][i] };
+        int half;
+
+        for (j = 0; j < REVERB_FDN_LINES; j++) {
+            y[j] = fdn->line[j][fdn->pos[j]];
+            out[j & 1] += y[j];
         }
-#endif
 
-        nbytes -= 16 * sizeof(int16_t);
+        // Feed the lines back through a Hadamard matrix, which keeps the level and spreads
+        // every line over all the others
+        for (half = 1; half < REVERB_FDN_LINES; half *= 2) {
+            for (j = 0; j < REVERB_FDN_LINES; j++) {
+                if ((j & half) == 0) {
+                    float a = y[j];
+                    float b = y[j + half];
+                    y[j] = a + b;
+                    y[j + half] = a - b;
+                }
+            }
+        }
+        for (j = 0; j < REVERB_FDN_LINES; j++) {
+            float v = y[j] * 0.35355339f; // 1 / sqrt(REVERB_FDN_LINES)
+
+            fdn->lowpass[j] += fdn->damping * (v - fdn->lowpass[j]);
+            v = in[j & 1] + fdn->feedback[j] * fdn->lowpass[j];
+            fdn->line[j][fdn->pos[j]] = (v + REVERB_FDN_DENORMAL_GUARD) - REVERB_FDN_DENORMAL_GUARD;
+            if (++fdn->pos[j] == fdn->length[j]) {
+                fdn->pos[j] = 0;
+            }
+        }
+
+        // Half the lines of each side, at 1 / sqrt(lines per side) they carry about as much as
+        // the single echo of the N64 reverb
+        for (j = 0; j < 2; j++) {
+            float v = out[j] * 0.5f;
+            dry[j][i] = clamp16(dry[j][i] + (int32_t)(v < 0.0f ? v - 0.5f : v + 0.5f));
+        }
     }
 }
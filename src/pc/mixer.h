@@ -1,9 +1,41 @@
 #ifndef MIXER_H
 #define MIXER_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <ultra64.h>
 
+// Describes a whole ADPCM sample so its decoded PCM can be cached across notes
+struct ADPCMSampleInfo {
+    const void *key;          // identifies the sample, e.g. its AudioBankSample
+    const uint8_t *data;      // first 9-byte frame
+    int num_frames;           // frames that playback can reach
+    int loop_frame;           // first frame decoded after a loop restart, -1 if the sample doesn't loop
+    const int16_t *loop_state;
+};
+
+// Feedback delay network of the high quality reverb, see aReverbFDN
+#define REVERB_FDN_LINES 8
+struct ReverbFDN {
+    float *buf;
+    float *line[REVERB_FDN_LINES];
+    int length[REVERB_FDN_LINES];
+    int pos[REVERB_FDN_LINES];
+    float feedback[REVERB_FDN_LINES];
+    float lowpass[REVERB_FDN_LINES];
+    float damping;
+    int delay;     // longest line, the delay of the ring buffer it stands in for
+    uint16_t gain; // N64 reverb gain the feedback was computed for
+};
+
+// Mixing into a range of DMEM recorded on one thread, to be replayed on another
+struct MixerBusLog {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
 #undef aSegment
 #undef aClearBuffer
 #undef aSetBuffer
@@ -27,12 +59,30 @@ void aLoadADPCMImpl(int num_entries_times_16, const int16_t *book_source_addr);
 void aSetBufferImpl(uint8_t flags, uint16_t in, uint16_t out, uint16_t nbytes);
 void aSetVolumeImpl(uint8_t flags, int16_t v, int16_t t, int16_t r);
 void aInterleaveImpl(uint16_t left, uint16_t right);
+void aInterleaveSaveImpl(int16_t *dest_addr, uint16_t left, uint16_t right);
 void aDMEMMoveImpl(uint16_t in_addr, uint16_t out_addr, int nbytes);
 void aSetLoopImpl(ADPCM_STATE *adpcm_loop_state);
 void aADPCMdecImpl(uint8_t flags, ADPCM_STATE state);
+void aADPCMdecFromImpl(uint8_t flags, ADPCM_STATE state, const uint8_t *source_addr);
+void aADPCMdecSampleImpl(uint8_t flags, ADPCM_STATE state, const uint8_t *source_addr,
+                         const struct ADPCMSampleInfo *sample, int frame);
 void aResampleImpl(uint8_t flags, uint16_t pitch, RESAMPLE_STATE state);
 void aEnvMixerImpl(uint8_t flags, ENVMIX_STATE state);
 void aMixImpl(int16_t gain, uint16_t in_addr, uint16_t out_addr);
+void aReverbFDNImpl(struct ReverbFDN *fdn, uint16_t gain);
+
+// While recording, env mixer and mix outputs that land in [start, end) leave this thread's
+// DMEM alone and go to the log instead. Replaying the log applies them to the calling thread's
+// DMEM with the same rounding and saturation, and leaves the buffer and volume settings undefined.
+void mixer_record_bus(struct MixerBusLog *log, uint16_t start, uint16_t end);
+void mixer_replay_bus(const struct MixerBusLog *log);
+
+// Copies every step-th sample of src to count samples of dest, the CPU side of a downsampled reverb
+void mixer_downsample(int16_t *dest, const int16_t *src, int count, int step);
+
+// Sets up a network with lines up to delay samples long, silent and with no feedback yet.
+// Returns false if there is no memory for the lines, aReverbFDN does nothing then.
+bool mixer_reverb_fdn_init(struct ReverbFDN *fdn, int delay, int rate);
 
 #define aSegment(pkt, s, b) do { } while(0)
 #define aClearBuffer(pkt, d, c) aClearBufferImpl(d, c)
@@ -50,4 +100,15 @@ void aMixImpl(int16_t gain, uint16_t in_addr, uint16_t out_addr);
 #define aEnvMixer(pkt, f, s) aEnvMixerImpl(f, s)
 #define aMix(pkt, f, g, i, o) aMixImpl(g, i, o)
 
+// Direct-call variants without an RSP equivalent: they read and write main memory
+// instead of staging the data through DMEM with aLoadBuffer/aSaveBuffer.
+#define aInterleaveSave(pkt, d, l, r) aInterleaveSaveImpl(d, l, r)
+#define aADPCMdecFrom(pkt, f, s, src) aADPCMdecFromImpl(f, s, src)
+// Same as aADPCMdecFrom, where src is frame number fr of the given sample
+#define aADPCMdecSample(pkt, f, s, src, smp, fr) aADPCMdecSampleImpl(f, s, src, smp, fr)
+// Runs count bytes of the wet buses through the network and adds its output to the dry buses,
+// with the buses set up as for aEnvMixer. gain is the reverb gain of the N64 ring buffer, which
+// sets how fast the network decays.
+#define aReverbFDN(pkt, fdn, g) aReverbFDNImpl(fdn, g)
+
 #endif
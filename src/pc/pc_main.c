@@ -8,6 +8,7 @@
 #include "sm64.h"
 
 #include "game/memory.h"
+#include "engine/surface_load.h"
 #include "audio/external.h"
 
 #include "gfx/gfx_pc.h"
@@ -22,8 +23,13 @@
 #include "audio/audio_wasapi.h"
 #include "audio/audio_pulse.h"
 #include "audio/audio_alsa.h"
+#include "audio/audio_alsa_mmap.h"
 #include "audio/audio_sdl.h"
 #include "audio/audio_null.h"
+#include "audio/audio_capture.h"
+#include "audio/audio_thread.h"
+#include "audio/audio_latency.h"
+#include "audio/audio_workers.h"
 
 #include "controller/controller_keyboard.h"
 
@@ -43,6 +49,7 @@ s8 gShowProfiler;
 s8 gShowDebugText;
 
 static struct AudioAPI *audio_api;
+uint32_t audio_output_frequency = 32000;
 static struct GfxWindowManagerAPI *wm_api;
 static struct GfxRenderingAPI *rendering_api;
 
@@ -69,32 +76,43 @@ void send_display_list(struct SPTask *spTask) {
 
 #define printf
 
-#ifdef VERSION_EU
-#define SAMPLES_HIGH 656
-#define SAMPLES_LOW 640
-#else
-#define SAMPLES_HIGH 544
-#define SAMPLES_LOW 528
+static u32 samples_high;
+static u32 samples_low;
+
+#ifdef AUDIO_THREAD
+static bool audio_threaded;
 #endif
 
-void produce_one_frame(void) {
-    gfx_start_frame();
-    game_loop_one_iteration();
-    
+static void produce_audio(void) {
     int samples_left = audio_api->buffered();
-    u32 num_audio_samples = samples_left < audio_api->get_desired_buffered() ? SAMPLES_HIGH : SAMPLES_LOW;
-    //printf("Audio samples: %d %u\n", samples_left, num_audio_samples);
-    s16 audio_buffer[SAMPLES_HIGH * 2 * 2];
+    u32 num_audio_samples = 0;
+    s16 audio_buffer[SAMPLES_HIGH_MAX * 2 * 2];
+
+    audio_latency_update(samples_left);
     for (int i = 0; i < 2; i++) {
-        /*if (audio_cnt-- == 0) {
-            audio_cnt = 2;
-        }
-        u32 num_audio_samples = audio_cnt < 2 ? 528 : 544;*/
-        create_next_audio_buffer(audio_buffer + i * (num_audio_samples * 2), num_audio_samples);
+        u32 count = audio_latency_next_count();
+        create_next_audio_buffer(audio_buffer + num_audio_samples * 2, count);
+        num_audio_samples += count;
     }
     //printf("Audio samples before submitting: %d\n", audio_api->buffered());
-    audio_api->play((u8 *)audio_buffer, 2 * num_audio_samples * 4);
-    
+    if (audio_latency_submit(samples_left)) {
+        audio_api->play((u8 *)audio_buffer, num_audio_samples * 4);
+    }
+}
+
+void produce_one_frame(void) {
+    gfx_start_frame();
+    game_loop_one_iteration();
+
+#ifdef AUDIO_THREAD
+    // The audio thread synthesizes on its own clock
+    if (!audio_threaded) {
+        produce_audio();
+    }
+#else
+    produce_audio();
+#endif
+
     gfx_end_frame();
 }
 
@@ -140,7 +158,9 @@ static void on_fullscreen_changed(bool is_now_fullscreen) {
 }
 
 void main_func(void) {
-    static u64 pool[0x165000/8 / 4 * sizeof(void *)];
+    // Plus whatever the surface node pool needs beyond the original 7000 nodes
+    static u64 pool[0x165000/8 / 4 * sizeof(void *)
+                    + (SURFACE_NODE_POOL_SIZE - 7000) * sizeof(struct SurfaceNode) / 8];
     main_pool_init(pool, pool + sizeof(pool) / sizeof(pool[0]));
     gEffectsMemoryPool = mem_pool_init(0x4000, MEMORY_POOL_LEFT);
 
@@ -172,6 +192,19 @@ void main_func(void) {
     wm_api->set_fullscreen_changed_callback(on_fullscreen_changed);
     wm_api->set_keyboard_callbacks(keyboard_on_key_down, keyboard_on_key_up, keyboard_on_all_keys_up);
     
+    audio_output_frequency = configAudioFrequency;
+    if (audio_output_frequency < AUDIO_MIN_FREQUENCY) {
+        audio_output_frequency = AUDIO_MIN_FREQUENCY;
+    } else if (audio_output_frequency > AUDIO_MAX_FREQUENCY) {
+        audio_output_frequency = AUDIO_MAX_FREQUENCY;
+    }
+    samples_high = SAMPLES_HIGH_AT(audio_output_frequency);
+    samples_low = samples_high - 16;
+
+    // Capture to a file instead of a device when SM64_AUDIO_CAPTURE is set
+    if (audio_capture.init()) {
+        audio_api = &audio_capture;
+    }
 #if HAVE_WASAPI
     if (audio_api == NULL && audio_wasapi.init()) {
         audio_api = &audio_wasapi;
@@ -183,6 +216,9 @@ void main_func(void) {
     }
 #endif
 #if HAVE_ALSA
+    if (audio_api == NULL && audio_alsa_mmap.init()) {
+        audio_api = &audio_alsa_mmap;
+    }
     if (audio_api == NULL && audio_alsa.init()) {
         audio_api = &audio_alsa;
     }
@@ -196,8 +232,17 @@ void main_func(void) {
         audio_api = &audio_null;
     }
 
+    // Latency in ms from the config, or whatever the backend prefers
+    audio_latency_init(samples_low, samples_high,
+                       configAudioLatency != 0 ? configAudioLatency * audio_output_frequency / 1000
+                                               : (u32)audio_api->get_desired_buffered());
+
+    gReverbMode = configAudioReverb == REVERB_MODE_FDN ? REVERB_MODE_FDN : REVERB_MODE_N64;
     audio_init();
     sound_init();
+#ifdef AUDIO_WORKERS
+    audio_workers_start(configAudioThreads);
+#endif
 
     thread5_game_loop(NULL);
 #ifdef TARGET_WEB
@@ -206,6 +251,12 @@ void main_func(void) {
     }*/
     inited = 1;
 #else
+#ifdef AUDIO_THREAD
+    // Captured audio stays in step with the game frames
+    if (audio_api != &audio_null && audio_api != &audio_capture) {
+        audio_threaded = audio_thread_start(audio_api, create_next_audio_buffer, samples_high);
+    }
+#endif
     inited = 1;
     while (1) {
         wm_api->main_loop(produce_one_frame);
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ultra64.h>
+
+#include "audio/external.h"
+#include "game/area.h"
+#include "game/level_update.h"
+#include "game/object_list_processor.h"
+
+#include "../audio/audio_api.h"
+#include "../audio/audio_workers.h"
+
+/*
+    Offline renderer for the sound engine, built with `make audio_render`.
+
+    Links the audio engine and mixer without graphics, input or an output
+    device, plays a sequence and/or a sound effect and synthesizes a fixed
+    number of game frames as fast as possible. Prints the synthesis speed
+    and a hash of the output, which makes it usable both as a benchmark
+    for mixer and synthesis changes and as a regression test:
+
+        audio_render -s 0x0c -n 1800 -c <hash of a known good build>
+*/
+
+#define DEFAULT_FRAMES (30 * 60)
+
+// Game symbols the sound engine reads
+s16 gCurrLevelNum = LEVEL_MIN;
+s16 gCurrAreaIndex;
+s16 gMarioCurrentRoom;
+struct MarioState gMarioStates[1];
+
+uint32_t audio_output_frequency = 32000;
+
+void create_next_audio_buffer(s16 *samples, u32 num_samples);
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -s <id>      play sequence id on the level player\n"
+            "  -e <bits>    play a sound effect, given as its SOUND_ARG_LOAD bits\n"
+            "  -n <frames>  game frames to render at 30 per second (default %d)\n"
+            "  -r <rate>    output rate in Hz (default 32000)\n"
+            "  -j <count>   threads rendering notes (default 1)\n"
+            "  -v <mode>    reverb, 0 for the N64 one and 1 for the smoother one (default 0)\n"
+            "  -o <file>    write the output to a WAV file\n"
+            "  -c <hash>    compare the output hash, exit with status 1 if it differs\n",
+            name, DEFAULT_FRAMES);
+}
+
+static void write_u16(FILE *f, uint16_t v) {
+    fputc(v & 0xff, f);
+    fputc(v >> 8, f);
+}
+
+static void write_u32(FILE *f, uint32_t v) {
+    write_u16(f, v & 0xffff);
+    write_u16(f, v >> 16);
+}
+
+static void write_wav_header(FILE *f, uint32_t rate, uint32_t num_frames) {
+    fwrite("RIFF", 1, 4, f);
+    write_u32(f, 36 + num_frames * 4);
+    fwrite("WAVEfmt ", 1, 8, f);
+    write_u32(f, 16);
+    write_u16(f, 1); // PCM
+    write_u16(f, 2);
+    write_u32(f, rate);
+    write_u32(f, rate * 4);
+    write_u16(f, 4);
+    write_u16(f, 16);
+    fwrite("data", 1, 4, f);
+    write_u32(f, num_frames * 4);
+}
+
+// FNV-1a over the little-endian samples, the same on every host
+static uint64_t hash_samples(uint64_t hash, const s16 *samples, u32 count) {
+    u32 i;
+
+    for (i = 0; i < count; i++) {
+        hash = (hash ^ (uint8_t)samples[i]) * 0x100000001b3ULL;
+        hash = (hash ^ (uint8_t)((uint16_t)samples[i] >> 8)) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    static s16 samples[SAMPLES_HIGH_MAX * 2];
+    const char *wav_name = NULL;
+    const char *expected_hash = NULL;
+    int seq_id = -1;
+    long sound_bits = 0;
+    long num_frames = DEFAULT_FRAMES;
+    long rate = 32000;
+    long threads = 1;
+    FILE *wav = NULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t total_samples = 0;
+    uint32_t samples_high;
+    uint32_t chunk = 0;
+    double synth_time = 0.0;
+    char hash_str[17];
+    long frame;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        const char *arg = i + 1 < argc ? argv[i + 1] : NULL;
+        if (arg == NULL || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage(argv[0]);
+            return 2;
+        }
+        switch (argv[i++][1]) {
+            case 's':
+                seq_id = strtol(arg, NULL, 0);
+                break;
+            case 'e':
+                sound_bits = strtoul(arg, NULL, 16);
+                break;
+            case 'n':
+                num_frames = strtol(arg, NULL, 0);
+                break;
+            case 'r':
+                rate = strtol(arg, NULL, 0);
+                break;
+            case 'j':
+                threads = strtol(arg, NULL, 0);
+                break;
+            case 'v':
+                gReverbMode = strtol(arg, NULL, 0) == REVERB_MODE_FDN ? REVERB_MODE_FDN : REVERB_MODE_N64;
+                break;
+            case 'o':
+                wav_name = arg;
+                break;
+            case 'c':
+                expected_hash = arg;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (seq_id < 0 && sound_bits == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (rate < AUDIO_MIN_FREQUENCY || rate > AUDIO_MAX_FREQUENCY) {
+        fprintf(stderr, "rate must be between %d and %d Hz\n", AUDIO_MIN_FREQUENCY, AUDIO_MAX_FREQUENCY);
+        return 2;
+    }
+    audio_output_frequency = rate;
+    samples_high = SAMPLES_HIGH_AT(audio_output_frequency);
+
+    if (wav_name != NULL) {
+        if ((wav = fopen(wav_name, "wb")) == NULL) {
+            perror(wav_name);
+            return 2;
+        }
+        write_wav_header(wav, audio_output_frequency, 0);
+    }
+
+    audio_init();
+    sound_init();
+#ifdef AUDIO_WORKERS
+    audio_workers_start(threads);
+#else
+    (void)threads;
+#endif
+
+    if (seq_id >= 0) {
+        play_music(SEQ_PLAYER_LEVEL, SEQUENCE_ARGS(4, seq_id), 0);
+    }
+    if (sound_bits != 0) {
+        play_sound(sound_bits, gDefaultSoundArgs);
+    }
+
+    for (frame = 0; frame < num_frames; frame++) {
+        audio_signal_game_loop_tick();
+
+        // Two audio frames per game frame in the fixed N64 pattern of two short ones and then a
+        // long one, instead of the sizes the latency controller picks, so the hash is reproducible
+        for (i = 0; i < 2; i++, chunk++) {
+            u32 count = chunk % 3 == 2 ? samples_high : samples_high - 16;
+            double start = seconds_now();
+
+            create_next_audio_buffer(samples, count);
+            synth_time += seconds_now() - start;
+
+            hash = hash_samples(hash, samples, count * 2);
+            total_samples += count;
+            if (wav != NULL) {
+                u32 j;
+                for (j = 0; j < count * 2; j++) {
+                    write_u16(wav, samples[j]);
+                }
+            }
+        }
+    }
+
+    if (wav != NULL) {
+        fseek(wav, 0, SEEK_SET);
+        write_wav_header(wav, audio_output_frequency, total_samples);
+        fclose(wav);
+    }
+
+    sprintf(hash_str, "%016llx", (unsigned long long)hash);
+    printf("%u samples at %u Hz in %.3f s: %.0f samples/s, %.1fx real time\n", total_samples,
+           audio_output_frequency, synth_time, total_samples / synth_time,
+           total_samples / synth_time / audio_output_frequency);
+    printf("hash %s\n", hash_str);
+
+    if (expected_hash != NULL && strcmp(expected_hash, hash_str) != 0) {
+        fprintf(stderr, "hash mismatch, expected %s\n", expected_hash);
+        return 1;
+    }
+    return 0;
+}
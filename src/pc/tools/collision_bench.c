@@ -0,0 +1,1000 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ultra64.h>
+
+#include "sm64.h"
+#include "behavior_data.h"
+#include "surface_terrains.h"
+#include "level_misc_macros.h"
+#include "engine/surface_collision.h"
+#include "engine/surface_load.h"
+#include "game/level_update.h"
+#include "game/object_list_processor.h"
+
+/*
+    Benchmark and fuzzer for the collision queries, built with
+    `make collision_bench`.
+
+    Loads the terrain of every level area through load_area_terrain without
+    graphics, objects or a level script, then runs a stream of queries through
+    find_floor, find_ceil, find_wall_collisions and find_water_level and
+    prints the queries per second of each per area. Every result is checked
+    against a plain walk of the cell lists written like the original code, so
+    any change to surface_collision.c that changes a result makes it exit with
+    status 1:
+
+        collision_bench -n 1000000 -s 1
+
+    The streams are random unless -r is given, -o records them to a file in
+    the same format for replaying later, one query per line after a line
+    naming the area:
+
+        area bob 1
+        f <flags> x y z                  find_floor
+        c <flags> x y z                  find_ceil
+        w <flags> x y z offsetY radius   find_wall_collisions
+        h <flags> x z                    find_water_level
+
+    where flags is 1 to query for the camera and 2 to include intangible floors.
+
+    The floor queries of each stream are then run again through find_floors, in
+    one batch per camera flag starting from an empty floor cache, and checked
+    the same way. find_floors never includes intangible floors, so that flag
+    doesn't apply to them there.
+*/
+
+#define DEFAULT_QUERIES 200000
+#define MAX_MISMATCHES_SHOWN 10
+
+#define QUERY_FLAG_CAMERA 1
+#define QUERY_FLAG_INTANGIBLE 2
+
+// Special objects are spawned by the level and not part of the terrain, so leave them out
+// of the collision data below. Continue commands keep the rest of the layout intact.
+#undef COL_SPECIAL_INIT
+#undef SPECIAL_OBJECT
+#undef SPECIAL_OBJECT_WITH_YAW
+#undef SPECIAL_OBJECT_WITH_YAW_AND_PARAM
+#define COL_SPECIAL_INIT(num) TERRAIN_LOAD_CONTINUE
+#define SPECIAL_OBJECT(preset, posX, posY, posZ) TERRAIN_LOAD_CONTINUE
+#define SPECIAL_OBJECT_WITH_YAW(preset, posX, posY, posZ, yaw) TERRAIN_LOAD_CONTINUE
+#define SPECIAL_OBJECT_WITH_YAW_AND_PARAM(preset, posX, posY, posZ, yaw, param) TERRAIN_LOAD_CONTINUE
+
+#include "levels/bbh/areas/1/collision.inc.c"
+#include "levels/bitdw/areas/1/collision.inc.c"
+#include "levels/bitfs/areas/1/collision.inc.c"
+#include "levels/bits/areas/1/collision.inc.c"
+#include "levels/bob/areas/1/collision.inc.c"
+#include "levels/bowser_1/areas/1/collision.inc.c"
+#include "levels/bowser_2/areas/1/collision.inc.c"
+#include "levels/bowser_3/areas/1/collision.inc.c"
+#include "levels/castle_courtyard/areas/1/collision.inc.c"
+#include "levels/castle_grounds/areas/1/collision.inc.c"
+#include "levels/castle_inside/areas/1/collision.inc.c"
+#include "levels/castle_inside/areas/2/collision.inc.c"
+#include "levels/castle_inside/areas/3/collision.inc.c"
+#include "levels/ccm/areas/1/collision.inc.c"
+#include "levels/ccm/areas/2/collision.inc.c"
+#include "levels/cotmc/areas/1/collision.inc.c"
+#include "levels/ddd/areas/1/collision.inc.c"
+#include "levels/ddd/areas/2/collision.inc.c"
+#include "levels/hmc/areas/1/collision.inc.c"
+#include "levels/jrb/areas/1/collision.inc.c"
+#include "levels/jrb/areas/2/collision.inc.c"
+#include "levels/lll/areas/1/collision.inc.c"
+#include "levels/lll/areas/2/collision.inc.c"
+#include "levels/pss/areas/1/collision.inc.c"
+#include "levels/rr/areas/1/collision.inc.c"
+#include "levels/sa/areas/1/collision.inc.c"
+#include "levels/sl/areas/1/collision.inc.c"
+#include "levels/sl/areas/2/collision.inc.c"
+#include "levels/ssl/areas/1/collision.inc.c"
+#include "levels/ssl/areas/2/collision.inc.c"
+#include "levels/ssl/areas/3/collision.inc.c"
+#include "levels/thi/areas/1/collision.inc.c"
+#include "levels/thi/areas/2/collision.inc.c"
+#include "levels/thi/areas/3/collision.inc.c"
+#include "levels/totwc/areas/1/collision.inc.c"
+#include "levels/ttc/areas/1/collision.inc.c"
+#include "levels/ttm/areas/1/collision.inc.c"
+#include "levels/ttm/areas/2/collision.inc.c"
+#include "levels/ttm/areas/3/collision.inc.c"
+#include "levels/ttm/areas/4/collision.inc.c"
+#include "levels/vcutm/areas/1/collision.inc.c"
+#include "levels/wdw/areas/1/collision.inc.c"
+#include "levels/wdw/areas/2/collision.inc.c"
+#include "levels/wf/areas/1/collision.inc.c"
+#include "levels/wmotr/areas/1/collision.inc.c"
+
+struct BenchArea {
+    const char *level;
+    s16 index;
+    const Collision *collision;
+};
+
+static const struct BenchArea sAreas[] = {
+    { "bbh", 1, bbh_seg7_collision_level },
+    { "bitdw", 1, bitdw_seg7_collision_level },
+    { "bitfs", 1, bitfs_seg7_collision_level },
+    { "bits", 1, bits_seg7_collision_level },
+    { "bob", 1, bob_seg7_collision_level },
+    { "bowser_1", 1, bowser_1_seg7_collision_level },
+    { "bowser_2", 1, bowser_2_seg7_collision_lava },
+    { "bowser_3", 1, bowser_3_seg7_collision_level },
+    { "castle_courtyard", 1, castle_courtyard_seg7_collision },
+    { "castle_grounds", 1, castle_grounds_seg7_collision_level },
+    { "castle_inside", 1, inside_castle_seg7_area_1_collision },
+    { "castle_inside", 2, inside_castle_seg7_area_2_collision },
+    { "castle_inside", 3, inside_castle_seg7_area_3_collision },
+    { "ccm", 1, ccm_seg7_area_1_collision },
+    { "ccm", 2, ccm_seg7_area_2_collision },
+    { "cotmc", 1, cotmc_seg7_collision_level },
+    { "ddd", 1, ddd_seg7_area_1_collision },
+    { "ddd", 2, ddd_seg7_area_2_collision },
+    { "hmc", 1, hmc_seg7_collision_level },
+    { "jrb", 1, jrb_seg7_area_1_collision },
+    { "jrb", 2, jrb_seg7_area_2_collision },
+    { "lll", 1, lll_seg7_area_1_collision },
+    { "lll", 2, lll_seg7_area_2_collision },
+    { "pss", 1, pss_seg7_collision },
+    { "rr", 1, rr_seg7_collision_level },
+    { "sa", 1, sa_seg7_collision },
+    { "sl", 1, sl_seg7_area_1_collision },
+    { "sl", 2, sl_seg7_area_2_collision },
+    { "ssl", 1, ssl_seg7_area_1_collision },
+    { "ssl", 2, ssl_seg7_area_2_collision },
+    { "ssl", 3, ssl_seg7_area_3_collision },
+    { "thi", 1, thi_seg7_area_1_collision },
+    { "thi", 2, thi_seg7_area_2_collision },
+    { "thi", 3, thi_seg7_area_3_collision },
+    { "totwc", 1, totwc_seg7_collision },
+    { "ttc", 1, ttc_seg7_collision_level },
+    { "ttm", 1, ttm_seg7_area_1_collision },
+    { "ttm", 2, ttm_seg7_area_2_collision },
+    { "ttm", 3, ttm_seg7_area_3_collision },
+    { "ttm", 4, ttm_seg7_area_4_collision },
+    { "vcutm", 1, vcutm_seg7_collision },
+    { "wdw", 1, wdw_seg7_area_1_collision },
+    { "wdw", 2, wdw_seg7_area_2_collision },
+    { "wf", 1, wf_seg7_collision_070102D8 },
+    { "wmotr", 1, wmotr_seg7_collision },
+};
+
+enum QueryKind { QUERY_FLOOR, QUERY_CEIL, QUERY_WALL, QUERY_WATER, QUERY_KIND_COUNT };
+
+static const char sKindChars[QUERY_KIND_COUNT] = { 'f', 'c', 'w', 'h' };
+static const char *sKindNames[QUERY_KIND_COUNT] = { "floor", "ceil", "wall", "water" };
+
+struct Query {
+    u8 kind;
+    u8 flags;
+    f32 x, y, z;
+    f32 offsetY, radius;
+};
+
+struct QueryResult {
+    s32 count;
+    f32 x, z; // height in x for everything but walls
+    struct Surface *surfaces[4];
+};
+
+// Game symbols the collision code reads
+s16 gCheckingSurfaceCollisionsForCamera;
+s16 gFindFloorIncludeSurfaceIntangible;
+s16 *gEnvironmentRegions;
+s32 gEnvironmentLevels[20];
+s32 gSurfaceNodesAllocated;
+s32 gSurfacesAllocated;
+s32 gNumStaticSurfaceNodes;
+s32 gNumStaticSurfaces;
+s32 gNumFindFloorMisses;
+s16 gCCMEnteredSlide;
+u32 gTimeStopState;
+struct NumTimesCalled gNumCalls;
+struct Object gObjectPool[OBJECT_POOL_CAPACITY];
+struct Object *gCurrentObject;
+struct Object *gMarioObject;
+struct MarioState *gMarioState;
+const BehaviorScript bhvDddWarp[1];
+
+extern struct Surface *sSurfacePool;
+
+void *main_pool_alloc(u32 size, UNUSED u32 side) {
+    void *buf = calloc(1, size);
+
+    if (buf == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    return buf;
+}
+
+void *segmented_to_virtual(const void *addr) {
+    return (void *) addr;
+}
+
+// Only reached for objects and macro objects, which the benchmark has none of
+static void unreachable(const char *name) {
+    fprintf(stderr, "%s called\n", name);
+    abort();
+}
+
+void reset_red_coins_collected(void) {
+}
+
+void spawn_special_objects(UNUSED s16 areaIndex, UNUSED s16 **specialObjList) {
+    unreachable("spawn_special_objects");
+}
+
+void spawn_macro_objects(UNUSED s16 areaIndex, UNUSED s16 *macroObjList) {
+    unreachable("spawn_macro_objects");
+}
+
+void spawn_macro_objects_hardcoded(UNUSED s16 areaIndex, UNUSED s16 *macroObjList) {
+    unreachable("spawn_macro_objects_hardcoded");
+}
+
+u32 get_special_objects_size(UNUSED s16 *data) {
+    unreachable("get_special_objects_size");
+    return 0;
+}
+
+f32 dist_between_objects(UNUSED struct Object *obj1, UNUSED struct Object *obj2) {
+    unreachable("dist_between_objects");
+    return 0.0f;
+}
+
+void obj_apply_scale_to_matrix(UNUSED struct Object *obj, UNUSED Mat4 dst, UNUSED Mat4 src) {
+    unreachable("obj_apply_scale_to_matrix");
+}
+
+void obj_build_transform_from_pos_and_angle(UNUSED struct Object *obj, UNUSED s16 posIndex,
+                                            UNUSED s16 angleIndex) {
+    unreachable("obj_build_transform_from_pos_and_angle");
+}
+
+void print_debug_top_down_mapinfo(UNUSED const char *str, UNUSED s32 number) {
+}
+
+void set_text_array_x_y(UNUSED s32 xOffset, UNUSED s32 yOffset) {
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -l <level>   only run the areas of a level, e.g. bob or castle_inside\n"
+            "  -n <count>   random queries per area (default %d)\n"
+            "  -s <seed>    seed of the random queries (default 1)\n"
+            "  -r <file>    replay the query streams in a file instead of random ones\n"
+            "  -o <file>    record the random query streams to a file\n",
+            name, DEFAULT_QUERIES);
+}
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**************************************************
+ *                   REFERENCE                    *
+ **************************************************/
+
+// The original list walks and cell lookups, kept simple on purpose. The benchmark loads
+// no objects, so only the static partition is searched. Results are compared bit for bit,
+// which holds as long as this file and the engine are built with the same flags.
+
+static struct Surface *ref_floor_from_list(struct SurfaceNode *node, s32 x, s32 y, s32 z, f32 *pheight) {
+    for (; node != NULL; node = node->next) {
+        struct Surface *surf = node->surface;
+        s32 x1 = surf->vertex1[0], z1 = surf->vertex1[2];
+        s32 x2 = surf->vertex2[0], z2 = surf->vertex2[2];
+        s32 x3 = surf->vertex3[0], z3 = surf->vertex3[2];
+        f32 nx, ny, nz, oo, height;
+
+        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) < 0
+            || (z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) < 0
+            || (z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) < 0) {
+            continue;
+        }
+        if (gCheckingSurfaceCollisionsForCamera ? (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION)
+                                                : surf->type == SURFACE_CAMERA_BOUNDARY) {
+            continue;
+        }
+
+        nx = surf->normal.x;
+        ny = surf->normal.y;
+        nz = surf->normal.z;
+        oo = surf->originOffset;
+        if (ny == 0.0f) {
+            continue;
+        }
+        height = -(x * nx + nz * z + oo) / ny;
+        if (y - (height + -78.0f) < 0.0f) {
+            continue;
+        }
+        *pheight = height;
+        return surf;
+    }
+    return NULL;
+}
+
+static struct Surface *ref_ceil_from_list(struct SurfaceNode *node, s32 x, s32 y, s32 z, f32 *pheight) {
+    for (; node != NULL; node = node->next) {
+        struct Surface *surf = node->surface;
+        s32 x1 = surf->vertex1[0], z1 = surf->vertex1[2];
+        s32 x2 = surf->vertex2[0], z2 = surf->vertex2[2];
+        s32 x3 = surf->vertex3[0], z3 = surf->vertex3[2];
+        f32 nx, ny, nz, oo, height;
+
+        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) > 0
+            || (z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) > 0
+            || (z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) > 0) {
+            continue;
+        }
+        if (gCheckingSurfaceCollisionsForCamera ? (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION)
+                                                : surf->type == SURFACE_CAMERA_BOUNDARY) {
+            continue;
+        }
+
+        nx = surf->normal.x;
+        ny = surf->normal.y;
+        nz = surf->normal.z;
+        oo = surf->originOffset;
+        if (ny == 0.0f) {
+            continue;
+        }
+        height = -(x * nx + nz * z + oo) / ny;
+        if (y - (height - -78.0f) > 0.0f) {
+            continue;
+        }
+        *pheight = height;
+        return surf;
+    }
+    return NULL;
+}
+
+// Whether (w, y) is on the inner side of the edge from (w1, y1) to (w2, y2), for a wall facing `sign`
+static s32 ref_wall_edge_inside(f32 sign, f32 w1, f32 y1, f32 w2, f32 y2, f32 w, f32 y) {
+    f32 cross = (y1 - y) * (w2 - w1) - (w1 - w) * (y2 - y1);
+    return sign > 0.0f ? !(cross > 0.0f) : !(cross < 0.0f);
+}
+
+static s32 ref_walls_from_list(struct SurfaceNode *node, struct WallCollisionData *data) {
+    f32 radius = data->radius < 200.0f ? data->radius : 200.0f;
+    f32 x = data->x;
+    f32 y = data->y + data->offsetY;
+    f32 z = data->z;
+    s32 numCols = 0;
+
+    for (; node != NULL; node = node->next) {
+        struct Surface *surf = node->surface;
+        f32 offset, w1, w2, w3, y1, y2, y3, w, sign;
+
+        if (y < surf->lowerY || y > surf->upperY) {
+            continue;
+        }
+        offset = surf->normal.x * x + surf->normal.y * y + surf->normal.z * z + surf->originOffset;
+        if (offset < -radius || offset > radius) {
+            continue;
+        }
+
+        y1 = surf->vertex1[1];
+        y2 = surf->vertex2[1];
+        y3 = surf->vertex3[1];
+        if (surf->flags & SURFACE_FLAG_X_PROJECTION) {
+            w1 = -surf->vertex1[2];
+            w2 = -surf->vertex2[2];
+            w3 = -surf->vertex3[2];
+            w = -z;
+            sign = surf->normal.x;
+        } else {
+            w1 = surf->vertex1[0];
+            w2 = surf->vertex2[0];
+            w3 = surf->vertex3[0];
+            w = x;
+            sign = surf->normal.z;
+        }
+        if (!ref_wall_edge_inside(sign, w1, y1, w2, y2, w, y)
+            || !ref_wall_edge_inside(sign, w2, y2, w3, y3, w, y)
+            || !ref_wall_edge_inside(sign, w3, y3, w1, y1, w, y)) {
+            continue;
+        }
+
+        if (gCheckingSurfaceCollisionsForCamera) {
+            if (surf->flags & SURFACE_FLAG_NO_CAM_COLLISION) {
+                continue;
+            }
+        } else {
+            if (surf->type == SURFACE_CAMERA_BOUNDARY) {
+                continue;
+            }
+            if (surf->type == SURFACE_VANISH_CAP_WALLS && gCurrentObject != NULL
+                && ((gCurrentObject->activeFlags & ACTIVE_FLAG_MOVE_THROUGH_GRATE)
+                    || (gCurrentObject == gMarioObject && (gMarioState->flags & MARIO_VANISH_CAP)))) {
+                continue;
+            }
+        }
+
+        data->x += surf->normal.x * (radius - offset);
+        data->z += surf->normal.z * (radius - offset);
+        if (data->numWalls < 4) {
+            data->walls[data->numWalls++] = surf;
+        }
+        numCols++;
+    }
+    return numCols;
+}
+
+// The static cell lists of a position, or NULL outside of the level boundary
+static SpatialPartitionCell *ref_cell(s16 x, s16 z) {
+    if (x <= -LEVEL_BOUNDARY_MAX || x >= LEVEL_BOUNDARY_MAX || z <= -LEVEL_BOUNDARY_MAX
+        || z >= LEVEL_BOUNDARY_MAX) {
+        return NULL;
+    }
+    return &gStaticSurfacePartition[(z + LEVEL_BOUNDARY_MAX) / CELL_SIZE][(x + LEVEL_BOUNDARY_MAX) / CELL_SIZE];
+}
+
+static f32 ref_find_floor(f32 xPos, f32 yPos, f32 zPos, s32 includeIntangible, struct Surface **pfloor) {
+    s16 x = (s16) xPos;
+    s16 y = (s16) yPos;
+    s16 z = (s16) zPos;
+    SpatialPartitionCell *cell = ref_cell(x, z);
+    f32 height = -11000.0f;
+    struct Surface *floor;
+
+    *pfloor = NULL;
+    if (cell == NULL) {
+        return height;
+    }
+
+    floor = ref_floor_from_list((*cell)[SPATIAL_PARTITION_FLOORS].next, x, y, z, &height);
+    if (!includeIntangible && floor != NULL && floor->type == SURFACE_INTANGIBLE) {
+        floor = ref_floor_from_list((*cell)[SPATIAL_PARTITION_FLOORS].next, x, (s32)(height - 200.0f), z, &height);
+    }
+    *pfloor = floor;
+    return height;
+}
+
+static f32 ref_find_ceil(f32 xPos, f32 yPos, f32 zPos, struct Surface **pceil) {
+    s16 x = (s16) xPos;
+    s16 y = (s16) yPos;
+    s16 z = (s16) zPos;
+    SpatialPartitionCell *cell = ref_cell(x, z);
+    f32 height = 20000.0f;
+
+    *pceil = NULL;
+    if (cell != NULL) {
+        *pceil = ref_ceil_from_list((*cell)[SPATIAL_PARTITION_CEILS].next, x, y, z, &height);
+    }
+    return height;
+}
+
+static s32 ref_find_wall_collisions(struct WallCollisionData *data) {
+    SpatialPartitionCell *cell = ref_cell((s16) data->x, (s16) data->z);
+
+    data->numWalls = 0;
+    if (cell == NULL) {
+        return 0;
+    }
+    return ref_walls_from_list((*cell)[SPATIAL_PARTITION_WALLS].next, data);
+}
+
+static f32 ref_find_water_level(f32 x, f32 z) {
+    s16 *p = gEnvironmentRegions;
+    s32 numRegions;
+    s32 i;
+
+    if (p == NULL) {
+        return -11000.0f;
+    }
+    numRegions = *p++;
+    for (i = 0; i < numRegions; i++, p += 6) {
+        if (p[1] < x && x < p[3] && p[2] < z && z < p[4] && p[0] < 50) {
+            return p[5];
+        }
+    }
+    return -11000.0f;
+}
+
+/**************************************************
+ *                    QUERIES                     *
+ **************************************************/
+
+static u64 sRandomState;
+
+// xorshift64*, so that a seed gives the same streams on every host
+static u32 random_u32(void) {
+    sRandomState ^= sRandomState >> 12;
+    sRandomState ^= sRandomState << 25;
+    sRandomState ^= sRandomState >> 27;
+    return (sRandomState * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+static f32 random_range(f32 lo, f32 hi) {
+    return lo + (hi - lo) * (random_u32() / 4294967296.0f);
+}
+
+/**
+ * Fill `queries` with a mix that looks like a game frame: most positions are just above,
+ * below or beside a surface of the area, some repeat a recent position like objects asking
+ * for the same floor again, and some are anywhere in or beyond the level.
+ */
+static void generate_queries(struct Query *queries, s32 count) {
+    struct Query *q;
+    f32 minX = LEVEL_BOUNDARY_MAX, minY = 20000.0f, minZ = LEVEL_BOUNDARY_MAX;
+    f32 maxX = -LEVEL_BOUNDARY_MAX, maxY = -11000.0f, maxZ = -LEVEL_BOUNDARY_MAX;
+    s32 i;
+
+    for (i = 0; i < gNumStaticSurfaces; i++) {
+        struct Surface *surf = &sSurfacePool[i];
+        minX = MIN(minX, MIN(surf->vertex1[0], MIN(surf->vertex2[0], surf->vertex3[0])));
+        maxX = MAX(maxX, MAX(surf->vertex1[0], MAX(surf->vertex2[0], surf->vertex3[0])));
+        minY = MIN(minY, surf->lowerY);
+        maxY = MAX(maxY, surf->upperY);
+        minZ = MIN(minZ, MIN(surf->vertex1[2], MIN(surf->vertex2[2], surf->vertex3[2])));
+        maxZ = MAX(maxZ, MAX(surf->vertex1[2], MAX(surf->vertex2[2], surf->vertex3[2])));
+    }
+
+    for (i = 0, q = queries; i < count; i++, q++) {
+        u32 kind = random_u32() % 10;
+        u32 where = random_u32() % 16;
+
+        q->kind = kind < 4 ? QUERY_FLOOR : kind < 6 ? QUERY_CEIL : kind < 9 ? QUERY_WALL : QUERY_WATER;
+        q->flags = (random_u32() % 8 == 0 ? QUERY_FLAG_CAMERA : 0)
+                   | (random_u32() % 16 == 0 ? QUERY_FLAG_INTANGIBLE : 0);
+        q->offsetY = (f32)(random_u32() % 4 * 50);
+        q->radius = random_range(5.0f, 250.0f);
+
+        if (where < 10 && gNumStaticSurfaces > 0) {
+            struct Surface *surf = &sSurfacePool[random_u32() % gNumStaticSurfaces];
+            f32 a = random_range(0.0f, 1.0f);
+            f32 b = random_range(0.0f, 1.0f);
+            f32 push = random_range(-100.0f, 300.0f);
+
+            if (a + b > 1.0f) {
+                a = 1.0f - a;
+                b = 1.0f - b;
+            }
+            q->x = surf->vertex1[0] + a * (surf->vertex2[0] - surf->vertex1[0]) + b * (surf->vertex3[0] - surf->vertex1[0]);
+            q->y = surf->vertex1[1] + a * (surf->vertex2[1] - surf->vertex1[1]) + b * (surf->vertex3[1] - surf->vertex1[1]);
+            q->z = surf->vertex1[2] + a * (surf->vertex2[2] - surf->vertex1[2]) + b * (surf->vertex3[2] - surf->vertex1[2]);
+            q->x += surf->normal.x * push;
+            q->y += surf->normal.y * push;
+            q->z += surf->normal.z * push;
+        } else if (where < 14 && i >= 16) {
+            struct Query *prev = &queries[i - 1 - random_u32() % 16];
+            q->x = prev->x;
+            q->y = prev->y;
+            q->z = prev->z;
+        } else if (where < 15) {
+            q->x = random_range(minX - 500.0f, maxX + 500.0f);
+            q->y = random_range(minY - 500.0f, maxY + 500.0f);
+            q->z = random_range(minZ - 500.0f, maxZ + 500.0f);
+        } else {
+            // Past the level boundary and the s16 range
+            q->x = random_range(-40000.0f, 40000.0f);
+            q->y = random_range(-40000.0f, 40000.0f);
+            q->z = random_range(-40000.0f, 40000.0f);
+        }
+    }
+}
+
+static void write_queries(FILE *f, const struct BenchArea *area, const struct Query *queries, s32 count) {
+    s32 i;
+
+    fprintf(f, "area %s %d\n", area->level, area->index);
+    for (i = 0; i < count; i++) {
+        const struct Query *q = &queries[i];
+
+        switch (q->kind) {
+            case QUERY_WALL:
+                fprintf(f, "w %d %.9g %.9g %.9g %.9g %.9g\n", q->flags, q->x, q->y, q->z, q->offsetY, q->radius);
+                break;
+            case QUERY_WATER:
+                fprintf(f, "h %d %.9g %.9g\n", q->flags, q->x, q->z);
+                break;
+            default:
+                fprintf(f, "%c %d %.9g %.9g %.9g\n", sKindChars[q->kind], q->flags, q->x, q->y, q->z);
+                break;
+        }
+    }
+}
+
+/**
+ * Parse one line of a recorded stream into `q`. Returns FALSE if it isn't a query.
+ */
+static s32 parse_query(const char *line, struct Query *q) {
+    char kind;
+    int flags;
+    s32 i;
+
+    memset(q, 0, sizeof(*q));
+    if (sscanf(line, " %c %d", &kind, &flags) != 2) {
+        return FALSE;
+    }
+    for (i = 0; i < QUERY_KIND_COUNT && sKindChars[i] != kind; i++) {
+    }
+    q->kind = i;
+    q->flags = flags;
+
+    switch (i) {
+        case QUERY_FLOOR:
+        case QUERY_CEIL:
+            return sscanf(line, " %*c %*d %f %f %f", &q->x, &q->y, &q->z) == 3;
+        case QUERY_WALL:
+            return sscanf(line, " %*c %*d %f %f %f %f %f", &q->x, &q->y, &q->z, &q->offsetY, &q->radius) == 5;
+        case QUERY_WATER:
+            return sscanf(line, " %*c %*d %f %f", &q->x, &q->z) == 2;
+        default:
+            return FALSE;
+    }
+}
+
+/**************************************************
+ *                    RUNNING                     *
+ **************************************************/
+
+static void set_query_flags(const struct Query *q) {
+    gCheckingSurfaceCollisionsForCamera = (q->flags & QUERY_FLAG_CAMERA) != 0;
+    gFindFloorIncludeSurfaceIntangible = (q->flags & QUERY_FLAG_INTANGIBLE) != 0;
+}
+
+static void run_query(const struct Query *q, struct QueryResult *r, s32 reference) {
+    struct WallCollisionData data;
+
+    memset(r, 0, sizeof(*r));
+    set_query_flags(q);
+
+    switch (q->kind) {
+        case QUERY_FLOOR:
+            if (reference) {
+                r->x = ref_find_floor(q->x, q->y, q->z, q->flags & QUERY_FLAG_INTANGIBLE, &r->surfaces[0]);
+            } else {
+                r->x = find_floor(q->x, q->y, q->z, &r->surfaces[0]);
+            }
+            break;
+        case QUERY_CEIL:
+            r->x = reference ? ref_find_ceil(q->x, q->y, q->z, &r->surfaces[0])
+                             : find_ceil(q->x, q->y, q->z, &r->surfaces[0]);
+            break;
+        case QUERY_WALL:
+            data.x = q->x;
+            data.y = q->y;
+            data.z = q->z;
+            data.offsetY = q->offsetY;
+            data.radius = q->radius;
+            data.numWalls = 0;
+            r->count = reference ? ref_find_wall_collisions(&data) : find_wall_collisions(&data);
+            r->x = data.x;
+            r->z = data.z;
+            memcpy(r->surfaces, data.walls, data.numWalls * sizeof(data.walls[0]));
+            break;
+        case QUERY_WATER:
+            r->x = reference ? ref_find_water_level(q->x, q->z) : find_water_level(q->x, q->z);
+            break;
+    }
+}
+
+static s32 surface_index(struct Surface *surf) {
+    return surf != NULL ? surf - sSurfacePool : -1;
+}
+
+static void print_mismatch(const struct BenchArea *area, const struct Query *q, const struct QueryResult *got,
+                           const struct QueryResult *expected) {
+    const struct QueryResult *results[2] = { got, expected };
+    s32 i;
+
+    fprintf(stderr, "%s %d: %s flags %d at (%.9g, %.9g, %.9g)", area->level, area->index, sKindNames[q->kind],
+            q->flags, q->x, q->y, q->z);
+    if (q->kind == QUERY_WALL) {
+        fprintf(stderr, " offset %.9g radius %.9g", q->offsetY, q->radius);
+    }
+    for (i = 0; i < 2; i++) {
+        const struct QueryResult *r = results[i];
+
+        fprintf(stderr, i == 0 ? "\n    got      " : "\n    expected ");
+        if (q->kind == QUERY_WALL) {
+            fprintf(stderr, "%d walls, pushed to (%.9g, %.9g), surfaces %d %d %d %d", r->count, r->x, r->z,
+                    surface_index(r->surfaces[0]), surface_index(r->surfaces[1]),
+                    surface_index(r->surfaces[2]), surface_index(r->surfaces[3]));
+        } else {
+            fprintf(stderr, "%.9g, surface %d", r->x, surface_index(r->surfaces[0]));
+        }
+    }
+    fprintf(stderr, "\n");
+}
+
+/**
+ * Run the floor queries through find_floors, one batch per camera flag, and compare every
+ * result with the reference. Returns the number of mismatches.
+ */
+static s32 bench_floor_batches(const struct BenchArea *area, const struct Query *queries, s32 count,
+                               double *time, s32 *numQueries) {
+    struct FloorQuery *batch = malloc(count * sizeof(struct FloorQuery));
+    s32 *indices = malloc(count * sizeof(s32));
+    s32 mismatches = 0;
+    s32 camera;
+    s32 n;
+    s32 i;
+
+    if (batch == NULL || indices == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+
+    *time = 0.0;
+    *numQueries = 0;
+    for (camera = FALSE; camera <= TRUE; camera++) {
+        double start;
+
+        for (i = 0, n = 0; i < count; i++) {
+            if (queries[i].kind == QUERY_FLOOR && ((queries[i].flags & QUERY_FLAG_CAMERA) != 0) == camera) {
+                batch[n].x = queries[i].x;
+                batch[n].y = queries[i].y;
+                batch[n].z = queries[i].z;
+                indices[n++] = i;
+            }
+        }
+
+        gCheckingSurfaceCollisionsForCamera = camera;
+        gFindFloorIncludeSurfaceIntangible = FALSE;
+        // Otherwise the batch would only read back what the find_floor pass left in the cache
+        clear_floor_cache();
+        start = seconds_now();
+        find_floors(batch, n);
+        *time += seconds_now() - start;
+        *numQueries += n;
+
+        for (i = 0; i < n; i++) {
+            struct QueryResult got;
+            struct QueryResult expected;
+
+            memset(&got, 0, sizeof(got));
+            memset(&expected, 0, sizeof(expected));
+            got.x = batch[i].height;
+            got.surfaces[0] = batch[i].floor;
+            expected.x = ref_find_floor(batch[i].x, batch[i].y, batch[i].z, FALSE, &expected.surfaces[0]);
+            if (memcmp(&got, &expected, sizeof(expected)) != 0) {
+                if (mismatches < MAX_MISMATCHES_SHOWN) {
+                    fprintf(stderr, "find_floors: ");
+                    print_mismatch(area, &queries[indices[i]], &got, &expected);
+                }
+                mismatches++;
+            }
+        }
+    }
+
+    free(indices);
+    free(batch);
+    return mismatches;
+}
+
+/**
+ * Load the terrain of an area, run the queries through the collision code timing each
+ * kind, and compare every result with the reference. Returns the number of mismatches.
+ */
+static s32 bench_area(const struct BenchArea *area, const struct Query *queries, s32 count) {
+    struct QueryResult *results = malloc(count * sizeof(struct QueryResult));
+    struct QueryResult expected;
+    double times[QUERY_KIND_COUNT] = { 0 };
+    s32 counts[QUERY_KIND_COUNT] = { 0 };
+    double batchTime;
+    s32 batchCount;
+    s32 mismatches = 0;
+    s32 kind;
+    s32 i;
+
+    if (results == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+
+    gCheckingSurfaceCollisionsForCamera = FALSE;
+    gFindFloorIncludeSurfaceIntangible = FALSE;
+    load_area_terrain(area->index, (s16 *) area->collision, NULL, NULL);
+
+    // One pass per kind, so that each timing only covers its own function
+    for (kind = 0; kind < QUERY_KIND_COUNT; kind++) {
+        double start = seconds_now();
+
+        for (i = 0; i < count; i++) {
+            if (queries[i].kind == kind) {
+                run_query(&queries[i], &results[i], FALSE);
+                counts[kind]++;
+            }
+        }
+        times[kind] = seconds_now() - start;
+    }
+
+    for (i = 0; i < count; i++) {
+        run_query(&queries[i], &expected, TRUE);
+        if (memcmp(&results[i], &expected, sizeof(expected)) != 0) {
+            if (mismatches < MAX_MISMATCHES_SHOWN) {
+                print_mismatch(area, &queries[i], &results[i], &expected);
+            }
+            mismatches++;
+        }
+    }
+
+    mismatches += bench_floor_batches(area, queries, count, &batchTime, &batchCount);
+
+    printf("%-16s %d %5d surfaces", area->level, area->index, gNumStaticSurfaces);
+    for (kind = 0; kind < QUERY_KIND_COUNT; kind++) {
+        printf("  %s %7.2f", sKindNames[kind], times[kind] > 0.0 ? counts[kind] / times[kind] * 1e-6 : 0.0);
+    }
+    printf("  floors %7.2f", batchTime > 0.0 ? batchCount / batchTime * 1e-6 : 0.0);
+    printf(" Mq/s");
+    if (mismatches != 0) {
+        printf("  %d MISMATCHES", mismatches);
+    }
+    printf("\n");
+
+    free(results);
+    return mismatches;
+}
+
+static const struct BenchArea *find_area(const char *level, s32 index) {
+    u32 i;
+
+    for (i = 0; i < ARRAY_COUNT(sAreas); i++) {
+        if (strcmp(sAreas[i].level, level) == 0 && sAreas[i].index == index) {
+            return &sAreas[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Run the streams of a recorded file, area by area.
+ */
+static s32 replay_file(FILE *f, const char *level_filter, s32 *numAreas) {
+    const struct BenchArea *area = NULL;
+    struct Query *queries = NULL;
+    s32 count = 0;
+    s32 capacity = 0;
+    s32 mismatches = 0;
+    s32 lineNum = 0;
+    char line[256];
+
+    while (TRUE) {
+        s32 eof = fgets(line, sizeof(line), f) == NULL;
+        char level[64];
+        int index;
+
+        lineNum++;
+        if (eof || sscanf(line, "area %63s %d", level, &index) == 2) {
+            if (area != NULL && (level_filter == NULL || strcmp(area->level, level_filter) == 0)) {
+                mismatches += bench_area(area, queries, count);
+                (*numAreas)++;
+            }
+            if (eof) {
+                break;
+            }
+            if ((area = find_area(level, index)) == NULL) {
+                fprintf(stderr, "line %d: unknown area %s %d\n", lineNum, level, index);
+                exit(2);
+            }
+            count = 0;
+            continue;
+        }
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (area == NULL) {
+            fprintf(stderr, "line %d: query before the first area line\n", lineNum);
+            exit(2);
+        }
+        if (count == capacity) {
+            capacity = capacity != 0 ? capacity * 2 : 4096;
+            if ((queries = realloc(queries, capacity * sizeof(struct Query))) == NULL) {
+                fprintf(stderr, "out of memory\n");
+                exit(2);
+            }
+        }
+        if (!parse_query(line, &queries[count])) {
+            fprintf(stderr, "line %d: bad query: %s", lineNum, line);
+            exit(2);
+        }
+        count++;
+    }
+
+    free(queries);
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    const char *level_filter = NULL;
+    const char *replay_name = NULL;
+    const char *record_name = NULL;
+    long count = DEFAULT_QUERIES;
+    unsigned long long seed = 1;
+    FILE *record = NULL;
+    s32 mismatches = 0;
+    s32 numAreas = 0;
+    double start;
+    u32 i;
+
+    for (i = 1; i < (u32) argc; i++) {
+        const char *arg = i + 1 < (u32) argc ? argv[i + 1] : NULL;
+        if (arg == NULL || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            usage(argv[0]);
+            return 2;
+        }
+        switch (argv[i++][1]) {
+            case 'l':
+                level_filter = arg;
+                break;
+            case 'n':
+                count = strtol(arg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoull(arg, NULL, 0);
+                break;
+            case 'r':
+                replay_name = arg;
+                break;
+            case 'o':
+                record_name = arg;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (count <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (record_name != NULL && (record = fopen(record_name, "w")) == NULL) {
+        perror(record_name);
+        return 2;
+    }
+
+    alloc_surface_pools();
+    start = seconds_now();
+
+    if (replay_name != NULL) {
+        FILE *f = fopen(replay_name, "r");
+
+        if (f == NULL) {
+            perror(replay_name);
+            return 2;
+        }
+        mismatches = replay_file(f, level_filter, &numAreas);
+        fclose(f);
+    } else {
+        struct Query *queries = malloc(count * sizeof(struct Query));
+
+        if (queries == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+        for (i = 0; i < ARRAY_COUNT(sAreas); i++) {
+            const struct BenchArea *area = &sAreas[i];
+
+            if (level_filter != NULL && strcmp(area->level, level_filter) != 0) {
+                continue;
+            }
+            // Each area has its own stream, so filtering by level doesn't change it
+            sRandomState = (seed + i) * 0x9E3779B97F4A7C15ULL | 1;
+            load_area_terrain(area->index, (s16 *) area->collision, NULL, NULL);
+            generate_queries(queries, count);
+            if (record != NULL) {
+                write_queries(record, area, queries, count);
+            }
+            mismatches += bench_area(area, queries, count);
+            numAreas++;
+        }
+        free(queries);
+    }
+
+    if (record != NULL) {
+        fclose(record);
+    }
+
+    printf("%d areas in %.3f s, %d mismatches\n", numAreas, seconds_now() - start, mismatches);
+    return mismatches != 0 ? 1 : 0;
+}